@@ -0,0 +1,182 @@
+#include "batch.h"
+#include "../ui/debug.h"
+
+BatchRunner::BatchRunner(Search const &search, BatchOptions options) : options(options), search(search){
+  if(this->options.threads <= 0) this->options.threads = std::max(1u, std::thread::hardware_concurrency());
+  maxInFlight = this->options.threads*2 + 2;
+}
+
+bool BatchRunner::run(){
+  if(options.task != "moves" && options.task != "status" && options.task != "perft" && options.task != "best" && options.task != "wdl"){
+    std::cout<<"[error] Unknown batch task "<<options.task<<", expected moves, status, perft, best or wdl"<<std::endl;
+    return false;
+  }
+  if(options.task == "perft" && (options.depth < 1 || options.depth > MAX_PERFT_DEPTH)){
+    std::cout<<"[error] The perft depth must be 1 to "<<MAX_PERFT_DEPTH<<std::endl;
+    return false;
+  }
+  if(options.task == "wdl" && !search.bitbases){
+    std::cout<<"[error] The wdl task needs --bitbases"<<std::endl;
+    return false;
+  }
+  std::ifstream in(options.input);
+  if(!in.is_open()){
+    std::cout<<"[error] Could not open "<<options.input<<std::endl;
+    return false;
+  }
+  std::ofstream out(options.output, std::ofstream::out | std::ofstream::trunc);
+  if(!out.is_open()){
+    std::cout<<"[error] Could not open "<<options.output<<std::endl;
+    return false;
+  }
+  std::cout<<"[batch "<<options.task<<" on "<<options.threads<<" threads]"<<std::endl;
+  auto start = std::chrono::steady_clock::now();
+  std::thread reader(&BatchRunner::readInput, this, std::ref(in));
+  std::vector<std::thread> workers;
+  for(int i = 0; i<options.threads; i++){
+    workers.emplace_back(&BatchRunner::work, this);
+  }
+
+  //write chunks in order as they finish
+  u64 next = 0;
+  u64 positions = 0;
+  while(true){
+    std::unique_ptr<Chunk> chunk;
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      outputReady.wait(guard, [&]{ return finished.count(next) || (readerDone && next == chunksRead); });
+      if(!finished.count(next)) break;
+      chunk = std::move(finished[next]);
+      finished.erase(next);
+    }
+    for(std::string const &result : chunk->results){
+      out<<result<<"\n";
+    }
+    positions += chunk->results.size();
+    next++;
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      inFlight--;
+    }
+    spaceReady.notify_one();
+  }
+  reader.join();
+  for(std::thread &t : workers) t.join();
+  out.close();
+
+  u64 ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now()-start).count();
+  std::cout<<"Processed "<<positions<<" positions in "<<(float)ms/1000.f<<"s";
+  std::cout<<" ("<<(positions*1000)/(ms ? ms : 1)<<" positions/s)"<<std::endl;
+  return !out.fail();
+}
+
+void BatchRunner::readInput(std::ifstream &in){
+  bool eof = false;
+  while(!eof){
+    auto chunk = std::make_unique<Chunk>();
+    std::string line;
+    while((int)chunk->lines.size() < options.chunkSize){
+      if(!std::getline(in, line)){
+        eof = true;
+        break;
+      }
+      chunk->lines.push_back(line);
+    }
+    if(chunk->lines.empty()) break;
+    std::unique_lock<std::mutex> guard(lock);
+    spaceReady.wait(guard, [&]{ return inFlight < maxInFlight; });
+    chunk->index = chunksRead++;
+    inFlight++;
+    pending.push(std::move(chunk));
+    inputReady.notify_one();
+  }
+  std::lock_guard<std::mutex> guard(lock);
+  readerDone = true;
+  inputReady.notify_all();
+  outputReady.notify_all();
+}
+
+void BatchRunner::work(){
+  Search localSearch = search;//shares the slider tables
+  Board board;
+  while(true){
+    std::unique_ptr<Chunk> chunk;
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      inputReady.wait(guard, [&]{ return !pending.empty() || readerDone; });
+      if(pending.empty()) return;
+      chunk = std::move(pending.front());
+      pending.pop();
+    }
+    chunk->results.reserve(chunk->lines.size());
+    if(options.task == "moves" || options.task == "status"){
+      processChunk(board, *chunk);
+    }else{
+      for(std::string const &line : chunk->lines){
+        chunk->results.push_back(processLine(board, localSearch, line));
+      }
+    }
+    chunk->lines.clear();
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      finished[chunk->index] = std::move(chunk);
+    }
+    outputReady.notify_one();
+  }
+}
+
+//moves and status only need legal move counts and check flags, the whole chunk goes through the batch kernel
+void BatchRunner::processChunk(Board &board, Chunk &chunk){
+  PositionBatch batch;
+  batch.reserve(chunk.lines.size());
+  std::vector<bool> valid(chunk.lines.size());
+  for(size_t i = 0; i<chunk.lines.size(); i++){
+    valid[i] = board.loadFromFEN(chunk.lines[i]);
+    if(valid[i]) batch.add(board);
+  }
+  BatchResults results;
+  countMovesBatch(batch, results);
+  int next = 0;
+  for(size_t i = 0; i<chunk.lines.size(); i++){
+    if(!valid[i]){
+      chunk.results.push_back("invalid");
+      continue;
+    }
+    int moves = results.moveCounts[next];
+    bool check = results.inCheck[next];
+    next++;
+    if(options.task == "moves"){
+      chunk.results.push_back(std::to_string(moves));
+    }else if(moves == 0){
+      chunk.results.push_back(check ? "mate" : "stalemate");
+    }else{
+      chunk.results.push_back(check ? "check" : "none");
+    }
+  }
+}
+
+std::string BatchRunner::processLine(Board &board, Search &localSearch, std::string const &line){
+  if(!board.loadFromFEN(line)) return "invalid";//also takes EPD lines
+
+  if(options.task == "perft"){
+    return std::to_string(localSearch.perft(board, options.depth));
+  }
+  if(options.task == "wdl"){
+    switch(localSearch.bitbases->probe(board)){
+      case BITBASE_WIN: return "win";
+      case BITBASE_DRAW: return "draw";
+      case BITBASE_LOSS: return "loss";
+    }
+    return "unknown";
+  }
+  //moves and status are done per chunk by processChunk
+  MoveList moves;
+  localSearch.generateMoves(board, moves);
+  if(options.task == "best"){
+    if(moves.end == 0) return "none";
+    int score;
+    Move m = localSearch.findBestMove(board, options.depth, score);
+    return debug::moveToUci(m, board.flags & WHITE_TO_MOVE_BIT) + " " + std::to_string(score);
+  }
+  return "unknown task";
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <condition_variable>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../Board/board.h"
+#include "../Search/search.h"
+#include "../Search/Attacks/positionbatch.h"
+
+struct BatchOptions{
+  std::string task = "moves";//moves, status, perft, best
+  std::string input;
+  std::string output;
+  int depth = 1;//perft depth or search depth
+  int threads = 0;//0 uses every core
+  int chunkSize = 4096;//lines per chunk
+};
+
+//Streams a file of FEN/EPD lines through a pool of workers, each with its own Board and Search
+//Results are written in input order, one line per input line
+//At most (threads*2 + 2) chunks are alive at once, so memory does not depend on the file size
+class BatchRunner{
+  struct Chunk{
+    u64 index;
+    std::vector<std::string> lines;
+    std::vector<std::string> results;
+  };
+  BatchOptions options;
+  Search const &search;
+
+  std::mutex lock;
+  std::condition_variable inputReady;//workers wait for chunks
+  std::condition_variable outputReady;//writer waits for the next chunk in order
+  std::condition_variable spaceReady;//reader waits for a chunk to be written
+  std::queue<std::unique_ptr<Chunk>> pending;
+  std::map<u64, std::unique_ptr<Chunk>> finished;//reordering queue
+  int inFlight = 0;
+  int maxInFlight = 0;
+  bool readerDone = false;
+  u64 chunksRead = 0;
+
+  void readInput(std::ifstream &in);
+  void work();
+  void processChunk(Board &board, Chunk &chunk);
+  std::string processLine(Board &board, Search &localSearch, std::string const &line);
+public:
+  BatchRunner(Search const &search, BatchOptions options);
+  bool run();
+};
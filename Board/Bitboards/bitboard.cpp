@@ -1,57 +1,43 @@
 #include "bitboard.h"
 
-u64 signedShift(u64 bb, int s){//positive = left shift
-  if(s>0){
-    return bb<<s;
+//the primitives are all in the header, this only checks them when it compiles
+//every single bit, every pair of bits and every low/high mask, the builtins against the portable versions
+namespace{
+constexpr bool checkBit(int i){
+  u64 bb = (u64)1<<i;
+  u64 low = bb | (bb-1);//bits 0..i
+  u64 high = ~(bb-1);//bits i..63
+  if(lsb(bb) != i || msb(bb) != i || popcount(bb) != 1) return false;
+  if(portable::lsb(bb) != i || portable::msb(bb) != i || portable::popcount(bb) != 1) return false;
+  if(lsb(low) != 0 || msb(low) != i || popcount(low) != i+1 || portable::popcount(low) != i+1) return false;
+  if(portable::msb(low) != i || portable::lsb(high) != i || lsb(high) != i) return false;
+  if(msb(high) != 63 || popcount(high) != 64-i || portable::popcount(high) != 64-i) return false;
+  for(int j = 0; j<i; j++){
+    u64 pair = bb | (u64)1<<j;
+    if(lsb(pair) != j || msb(pair) != i || popcount(pair) != 2) return false;
+    if(portable::lsb(pair) != j || portable::msb(pair) != i || portable::popcount(pair) != 2) return false;
+    int first = popLsb(pair);
+    if(first != j || pair != bb) return false;
   }
-  return bb>>abs(s);
+  if(!getBit(bb, i) || getBit(bb, (i+1)%64)) return false;
+  if(shift<8>(bb) != (i < 56 ? bb<<8 : 0) || shift<-8>(bb) != (i >= 8 ? bb>>8 : 0)) return false;
+  if(shift<9>(bb) != bb<<9 || shift<-7>(bb) != bb>>7) return false;
+  return true;
 }
 
-bool getBit(u64 bb, int index){
-  return (bb>>index) & (u64)1;
-};
-void setBit(u64 &bb, int index){
-  bb |= (u64)1<<index;
-};
-void resetBit(u64 &bb, int index){
-  bb &= ~((u64)1<<index);
-};
-
-const int index64[64] = {
-    0, 47,  1, 56, 48, 27,  2, 60,
-   57, 49, 41, 37, 28, 16,  3, 61,
-   54, 58, 35, 52, 50, 42, 21, 44,
-   38, 32, 29, 23, 17, 11,  4, 62,
-   46, 55, 26, 59, 40, 36, 15, 53,
-   34, 51, 20, 43, 31, 22, 10, 45,
-   25, 39, 14, 33, 19, 30,  9, 24,
-   13, 18,  8, 12,  7,  6,  5, 63
-};
-
-/**
- * bitScanForward
- * @author Kim Walisch (2012)
- * @param bb bitboard to scan
- * @precondition bb != 0
- * @return index (0..63) of least significant one bit
- */
-int bitScanForward(u64 bb) {
-  if(bb == 0) return -1;
-  const u64 debruijn64 = 0x03f79d71b4cb0a89;
-  return index64[((bb ^ (bb-1)) * debruijn64) >> 58];
+constexpr bool checkPrimitives(){
+  for(int i = 0; i<64; i++){
+    if(!checkBit(i)) return false;
+  }
+  //alternating patterns and every bit
+  if(popcount(0x5555555555555555ull) != 32 || portable::popcount(0xAAAAAAAAAAAAAAAAull) != 32) return false;
+  if(popcount(~0ull) != 64 || portable::popcount(~0ull) != 64 || popcount(0) != 0 || portable::popcount(0) != 0) return false;
+  u64 all = ~0ull;
+  for(int i = 0; i<64; i++){
+    if(popLsb(all) != i) return false;
+  }
+  return all == 0;
 }
-
-int popls1b(u64 &bb){
-  int index = bitScanForward(bb);
-  if(index == -1) std::cout<<"Cannot pop from empty bitboard"<<std::endl;
-  resetBit(bb,index);
-  return index;
 }
-int bitcount(u64 bb){
-  int count = 0;
-  while(bb){
-    popls1b(bb);
-    count++;
-  }
-  return count;
-}
\ No newline at end of file
+
+static_assert(checkPrimitives(), "bitboard primitives are wrong");
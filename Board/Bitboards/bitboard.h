@@ -4,11 +4,68 @@
 typedef unsigned char byte;
 typedef unsigned long long u64;
 
-bool getBit(u64 bb, int index);
-void setBit(u64 &bb, int index);
-void resetBit(u64 &bb, int index);
-
-int bitScanForward(u64 bb);
-int popls1b(u64 &bb);
-u64 signedShift(u64 bb, int s);
-int bitcount(u64 bb);
\ No newline at end of file
+//everything is inline and constexpr so the move generation loops compile down to single instructions
+//gcc and clang use builtins, they become tzcnt/lzcnt/popcnt/blsr when the target has them (make ARCH=-march=native)
+//the portable versions are used by other compilers and x86 targets without popcnt, and are checked against the builtins in bitboard.cpp
+
+constexpr bool getBit(u64 bb, int index){return (bb>>index) & (u64)1;}
+inline void setBit(u64 &bb, int index){bb |= (u64)1<<index;}
+inline void resetBit(u64 &bb, int index){bb &= ~((u64)1<<index);}
+
+namespace portable{
+  constexpr int index64[64] = {
+     0, 47,  1, 56, 48, 27,  2, 60,
+    57, 49, 41, 37, 28, 16,  3, 61,
+    54, 58, 35, 52, 50, 42, 21, 44,
+    38, 32, 29, 23, 17, 11,  4, 62,
+    46, 55, 26, 59, 40, 36, 15, 53,
+    34, 51, 20, 43, 31, 22, 10, 45,
+    25, 39, 14, 33, 19, 30,  9, 24,
+    13, 18,  8, 12,  7,  6,  5, 63
+  };
+  //De Bruijn bit scans by Kim Walisch (2012), bb != 0
+  constexpr int lsb(u64 bb){return index64[((bb ^ (bb-1)) * 0x03f79d71b4cb0a89ull) >> 58];}
+  constexpr int msb(u64 bb){
+    bb |= bb >> 1;
+    bb |= bb >> 2;
+    bb |= bb >> 4;
+    bb |= bb >> 8;
+    bb |= bb >> 16;
+    bb |= bb >> 32;
+    return index64[(bb * 0x03f79d71b4cb0a89ull) >> 58];
+  }
+  constexpr int popcount(u64 bb){
+    bb = bb - ((bb >> 1) & 0x5555555555555555ull);
+    bb = (bb & 0x3333333333333333ull) + ((bb >> 2) & 0x3333333333333333ull);
+    bb = (bb + (bb >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+    return (bb * 0x0101010101010101ull) >> 56;
+  }
+}
+
+#if defined(__GNUC__)
+constexpr int lsb(u64 bb){return __builtin_ctzll(bb);}//bb != 0
+constexpr int msb(u64 bb){return 63 ^ __builtin_clzll(bb);}//bb != 0
+#if defined(__POPCNT__) || !(defined(__x86_64__) || defined(__i386__))
+constexpr int popcount(u64 bb){return __builtin_popcountll(bb);}
+#else
+constexpr int popcount(u64 bb){return portable::popcount(bb);}//the builtin would be a library call
+#endif
+#else
+constexpr int lsb(u64 bb){return portable::lsb(bb);}
+constexpr int msb(u64 bb){return portable::msb(bb);}
+constexpr int popcount(u64 bb){return portable::popcount(bb);}
+#endif
+
+//removes and returns the lowest set bit, bb != 0
+constexpr int popLsb(u64 &bb){
+  int index = lsb(bb);
+  bb &= bb - 1;
+  return index;
+}
+
+//shift by a direction known at compile time, positive is towards higher squares (north is 8)
+template<int direction>
+constexpr u64 shift(u64 bb){
+  static_assert(direction > -64 && direction < 64, "shift out of range");
+  return direction > 0 ? bb << (direction > 0 ? direction : 0) : bb >> (direction < 0 ? -direction : 0);
+}
@@ -0,0 +1,58 @@
+#include "packed.h"
+#include <cstring>
+
+bool PackedBoard::encode(Position const &board){
+  occupancy = board.occupancy();
+  if(popcount(occupancy) > 32) return false;
+  pieces[0] = 0;
+  pieces[1] = 0;
+  u64 bb = occupancy;
+  int i = 0;
+  while(bb){
+    u64 piece = board.piece(popLsb(bb));
+    pieces[i>>4] |= piece << ((i&15)*4);
+    i++;
+  }
+  flags = board.flags & (WHITE_TO_MOVE_BIT | WHITE_CASTLING_RIGHTS | BLACK_CASTLING_RIGHTS);
+  enPassanTarget = board.enPassanTarget;
+  halfmoveClock = board.halfmoveClock;
+  fullmoveNumber = board.fullmoveNumber;
+  reserved = 0;
+  return true;
+}
+
+bool PackedBoard::decode(Position &board) const{
+  if(popcount(occupancy) > 32) return false;
+  bool enPassanValid = enPassanTarget == EN_PASSAN_NULL || (enPassanTarget >= 16 && enPassanTarget < 24) || (enPassanTarget >= 40 && enPassanTarget < 48);
+  if(!enPassanValid) return false;
+  for(u64 &bb : board.pieceBitboards) bb = 0;
+  board.colorBitboards[0] = board.colorBitboards[1] = 0;
+  for(u64 &m : board.mailbox) m = EMPTY_MAILBOX;
+  u64 bb = occupancy;
+  int i = 0;
+  while(bb){
+    int square = popLsb(bb);
+    byte piece = (pieces[i>>4] >> ((i&15)*4)) & 0xF;
+    if(piece >= 12) return false;//12 is EMPTY, above it are no pieces at all
+    board.setPiece(piece, square);
+    i++;
+  }
+  if(popcount(board.bitboard(WHITE+KING)) != 1 || popcount(board.bitboard(BLACK+KING)) != 1) return false;
+  board.flags = flags;
+  board.enPassanTarget = enPassanTarget;
+  board.halfmoveClock = halfmoveClock;
+  board.fullmoveNumber = fullmoveNumber;
+  board.key = board.computeHash();
+  board.pawnKey = board.computePawnHash();
+  return true;
+}
+
+bool PackedBoard::decode(Board &board) const{
+  if(!decode(static_cast<Position &>(board))) return false;
+  board.resetHistory();
+  return true;
+}
+
+bool PackedBoard::operator==(PackedBoard const &other) const{
+  return std::memcmp(this, &other, sizeof(PackedBoard)) == 0;
+}
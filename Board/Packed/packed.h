@@ -0,0 +1,22 @@
+#pragma once
+#include "../board.h"
+
+//32 byte position for storage and datasets
+//pieces holds one nibble (color+piece) per occupied square, in square order from h1
+struct PackedBoard{
+  u64 occupancy = 0;
+  u64 pieces[2] = {0, 0};
+  byte flags = 0;//side to move and castling rights, same bits as Board::flags
+  byte enPassanTarget = EN_PASSAN_NULL;
+  unsigned short halfmoveClock = 0;
+  unsigned short fullmoveNumber = 1;
+  unsigned short reserved = 0;
+
+  bool encode(Position const &board);//false if there are more than 32 pieces
+  //false for a record no encode could have written (a bad piece nibble, more than 32 pieces, a missing king
+  //or an impossible en passan square), the board is left partially loaded then
+  bool decode(Position &board) const;
+  bool decode(Board &board) const;//also starts a new history
+  bool operator==(PackedBoard const &other) const;
+};
+static_assert(sizeof(PackedBoard) == 32, "PackedBoard must stay 32 bytes");
@@ -0,0 +1,29 @@
+#include "zobrist.h"
+
+namespace zobrist{
+  u64 pieces[12][64];
+  u64 castling[16];
+  u64 enPassan[64];
+  u64 side;
+}
+
+namespace {
+u64 splitmix64(u64 &state){
+  u64 z = (state += 0x9E3779B97F4A7C15ull);
+  z = (z ^ (z>>30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z>>27)) * 0x94D049BB133111EBull;
+  return z ^ (z>>31);
+}
+
+struct ZobristInit{
+  ZobristInit(){
+    u64 state = 0x5EED;
+    for(auto &piece : zobrist::pieces)
+      for(u64 &key : piece) key = splitmix64(state);
+    zobrist::castling[0] = 0;
+    for(int i = 1; i<16; i++) zobrist::castling[i] = splitmix64(state);
+    for(u64 &key : zobrist::enPassan) key = splitmix64(state);
+    zobrist::side = splitmix64(state);
+  }
+} zobristInit;
+}
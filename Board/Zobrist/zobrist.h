@@ -0,0 +1,10 @@
+#pragma once
+#include "../Bitboards/bitboard.h"
+
+//Random keys for position hashing, filled once at startup from a fixed seed so hashes are the same on every run
+namespace zobrist{
+  extern u64 pieces[12][64];
+  extern u64 castling[16];//indexed by the four castling bits of Board::flags
+  extern u64 enPassan[64];//only the squares on the third and sixth rank are used
+  extern u64 side;//xored in when black is to move
+}
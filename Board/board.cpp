@@ -1,285 +1,420 @@
+#include <algorithm>
+#include <cassert>
 #include <cmath>
 #include "board.h"
+#include "Zobrist/zobrist.h"
 int getSquareIndex(int rank, int file){return (rank*8) + file;};
-void Board::updateColorBitboards(){
-  bitboards[WHITE_PIECES] = bitboards[WHITE+PAWN] | bitboards[WHITE+BISHOP] | bitboards[WHITE+KNIGHT] | bitboards[WHITE+ROOK] | bitboards[WHITE+QUEEN] | bitboards[WHITE+KING];
-  bitboards[BLACK_PIECES] = bitboards[BLACK+PAWN] | bitboards[BLACK+BISHOP] | bitboards[BLACK+KNIGHT] | bitboards[BLACK+ROOK] | bitboards[BLACK+QUEEN] | bitboards[BLACK+KING];
-  occupancy = bitboards[WHITE_PIECES]|bitboards[BLACK_PIECES];
-}
-bool Board::validate() const{//Way too expensive to use ouside of debugging
-  if(bitScanForward(bitboards[WHITE+KING]) == -1) return false;
-  if(bitScanForward(bitboards[BLACK+KING]) == -1) return false;
-  if(enPassanTarget == 1) return false;
-  int white = 0;
-  u64 whitebb = bitboards[WHITE+PAWN];
-  while(whitebb){
-    white++;
-    popls1b(whitebb);
+//computed from scratch, en passan is included whenever the target is set
+u64 Position::computeHash() const{
+  u64 key = 0;
+  u64 bb = occupancy();
+  while(bb){
+    int square = popLsb(bb);
+    key ^= zobrist::pieces[piece(square)][square];
   }
-  int black = 0;
-  u64 blackbb = bitboards[BLACK+PAWN];
-  while(blackbb){
-    black++;
-    popls1b(blackbb);
+  key ^= zobrist::castling[(flags & (WHITE_CASTLING_RIGHTS | BLACK_CASTLING_RIGHTS))>>1];
+  if(enPassanTarget != EN_PASSAN_NULL) key ^= zobrist::enPassan[enPassanTarget];
+  if(!(flags & WHITE_TO_MOVE_BIT)) key ^= zobrist::side;
+  return key;
+}
+
+u64 Position::computePawnHash() const{
+  u64 key = 0;
+  for(int color : {WHITE, BLACK}){
+    u64 pawns = bitboard(color+PAWN);
+    while(pawns){
+      int square = popLsb(pawns);
+      key ^= zobrist::pieces[color+PAWN][square];
+    }
   }
-  if(white>8) return false;
-  if(black>8) return false;
+  return key;
+}
+
+bool Position::validate() const{//Way too expensive to use ouside of debugging
+  if(!bitboard(WHITE+KING)) return false;
+  if(!bitboard(BLACK+KING)) return false;
+  if(enPassanTarget == 1) return false;
+  if(hash() != computeHash()) return false;
+  if(pawnHash() != computePawnHash()) return false;
+  if(popcount(bitboard(WHITE+PAWN))>8) return false;
+  if(popcount(bitboard(BLACK+PAWN))>8) return false;
+  if(colorBitboards[0] & colorBitboards[1]) return false;
 
   //make sure piecewise lookup table is correct
   for(int i = 0; i <64; i++){
     for(int j = 0; j<= BLACK+KING;j++){
-      if(getBit(bitboards[j],i)){
-        if(squares[i] != j) return false;
+      if(getBit(bitboard(j),i)){
+        if(piece(i) != j) return false;
       }
     }
+    if(!getBit(occupancy(), i) && piece(i) != EMPTY) return false;
   }
   return true;
 }
-void Board::loadFromFEN(std::string fen){
-  std::string parsed[6];
-  int index = 0;
-  for(char c: fen){
-    if(c == ' '){
-      index++;
-      continue;
-    }
-    parsed[index].push_back(c);
+namespace {
+//tabs and line ends separate fields too, crlf and tab separated files load the same
+inline bool isSeparator(char c){return c == ' ' || c == '\t' || c == '\r' || c == '\n';}
+
+//splits off the next whitespace separated field, returns an empty view at the end
+std::string_view nextField(std::string_view &fen){
+  size_t begin = 0;
+  while(begin < fen.size() && isSeparator(fen[begin])) begin++;
+  size_t end = begin;
+  while(end < fen.size() && !isSeparator(fen[end])) end++;
+  std::string_view field = fen.substr(begin, end-begin);
+  fen.remove_prefix(end);
+  return field;
+}
+
+bool parseNumber(std::string_view field, unsigned short &out){
+  if(field.empty() || field.size() > 5) return false;
+  unsigned int value = 0;
+  for(char c : field){
+    if(c < '0' || c > '9') return false;
+    value = value*10 + (c-'0');
   }
-  for(u64 &bb : bitboards){
+  if(value > 65535) return false;
+  out = value;
+  return true;
+}
+
+char *writeNumber(char *p, unsigned int value){
+  char digits[5];
+  int count = 0;
+  do{
+    digits[count++] = '0' + value%10;
+    value /= 10;
+  }while(value);
+  while(count) *p++ = digits[--count];
+  return p;
+}
+}
+
+//Accepts FEN and EPD, the clocks are optional and anything after them (EPD operations) is ignored
+//Returns false if the position is malformed, the board is left partially loaded in that case
+bool Position::loadFromFEN(std::string_view fen){
+  std::string_view placement = nextField(fen);
+  std::string_view side = nextField(fen);
+  std::string_view castling = nextField(fen);
+  std::string_view enPassan = nextField(fen);
+
+  for(u64 &bb : pieceBitboards){
     bb = (u64)0;
   }
-  for(byte &b : squares){
-    b = EMPTY;
+  colorBitboards[0] = colorBitboards[1] = 0;
+  for(u64 &m : mailbox){
+    m = EMPTY_MAILBOX;
   }
-  int squareIndex = 63;
-  for(char c: parsed[0]){
-    if(c == '/') continue;
-    if(isdigit(c)){
-      for(int i = 0; i<c-'0'; i++){
-        squares[squareIndex] = EMPTY;
-        squareIndex -=1;
-      }
-    }else{
-      int color = isupper(c) ? WHITE : BLACK;
-      int piece = 0;
-      switch(std::tolower(c)){
-        case 'p': piece = PAWN; break;
-        case 'b': piece = BISHOP; break;
-        case 'n': piece = KNIGHT; break;
-        case 'r': piece = ROOK; break;
-        case 'k': piece = KING; break;
-        case 'q': piece = QUEEN; break;
-      }
-      setBit(bitboards[color+piece],squareIndex);
-      squares[squareIndex] = color+piece;
-      squareIndex-=1;
+  int rank = 7;
+  int file = 0;//counted from the a file, squares are indexed from the h file
+  for(char c : placement){
+    if(c == '/'){
+      if(file != 8 || rank == 0) return false;
+      rank--;
+      file = 0;
+      continue;
+    }
+    if(c >= '1' && c <= '8'){
+      file += c-'0';
+      if(file > 8) return false;
+      continue;
     }
-    if(squareIndex<0){break;}
+    int piece;
+    switch(c|0x20){//lower case
+      case 'p': piece = PAWN; break;
+      case 'b': piece = BISHOP; break;
+      case 'n': piece = KNIGHT; break;
+      case 'r': piece = ROOK; break;
+      case 'q': piece = QUEEN; break;
+      case 'k': piece = KING; break;
+      default: return false;
+    }
+    if(file >= 8) return false;
+    int color = (c & 0x20) ? BLACK : WHITE;
+    int squareIndex = rank*8 + 7-file;
+    setPiece(color+piece, squareIndex);
+    file++;
   }
-  updateColorBitboards();
+  if(rank != 0 || file != 8) return false;
+  if(popcount(bitboard(WHITE+KING)) != 1 || popcount(bitboard(BLACK+KING)) != 1) return false;
+  if(pieceBitboards[PAWN] & 0xFF000000000000FFull) return false;//pawns on the first or last rank
 
   //set flags
-  flags = (u64)0;
-  if(parsed[1] == "w")
-    flags |= WHITE_TO_MOVE_BIT;
+  flags = 0;
+  if(side == "w") flags |= WHITE_TO_MOVE_BIT;
+  else if(side != "b") return false;
 
-  if(parsed[2].find("K") != parsed[2].npos) flags |= WHITE_KINGSIDE_BIT;
-  if(parsed[2].find("Q") != parsed[2].npos) flags |= WHITE_QUEENSIDE_BIT;
-  if(parsed[2].find("k") != parsed[2].npos) flags |= BLACK_KINGSIDE_BIT;
-  if(parsed[2].find("q") != parsed[2].npos) flags |= BLACK_QUEENSIDE_BIT;
+  if(castling != "-"){
+    if(castling.empty()) return false;
+    for(char c : castling){
+      switch(c){
+        case 'K': flags |= WHITE_KINGSIDE_BIT; break;
+        case 'Q': flags |= WHITE_QUEENSIDE_BIT; break;
+        case 'k': flags |= BLACK_KINGSIDE_BIT; break;
+        case 'q': flags |= BLACK_QUEENSIDE_BIT; break;
+        default: return false;
+      }
+    }
+  }
+
+  //some fens leave out the en passan square and go straight to the clocks
+  std::string_view clocks[2];
+  int clockCount = 0;
   enPassanTarget = EN_PASSAN_NULL;
-  if(!std::isdigit(parsed[3][0])){
-    if(parsed[3] != "-"){
-      std::cout<<"En passan target from fen not yet implemented"<<std::endl;
+  if(!enPassan.empty() && enPassan[0] >= '0' && enPassan[0] <= '9'){
+    clocks[clockCount++] = enPassan;
+  }else if(enPassan != "-" && !enPassan.empty()){
+    if(enPassan.size() != 2 || enPassan[0] < 'a' || enPassan[0] > 'h') return false;
+    char expectedRank = (flags & WHITE_TO_MOVE_BIT) ? '6' : '3';
+    if(enPassan[1] != expectedRank) return false;
+    enPassanTarget = (enPassan[1]-'1')*8 + ('h'-enPassan[0]);
+  }
+  while(clockCount < 2){
+    std::string_view field = nextField(fen);
+    if(field.empty() || field[0] < '0' || field[0] > '9') break;
+    clocks[clockCount++] = field;
+  }
+  halfmoveClock = 0;
+  fullmoveNumber = 1;
+  if(clockCount > 0 && !parseNumber(clocks[0], halfmoveClock)) return false;
+  if(clockCount > 1 && !parseNumber(clocks[1], fullmoveNumber)) return false;
+  if(fullmoveNumber == 0) fullmoveNumber = 1;
+  key = computeHash();
+  pawnKey = computePawnHash();
+  return true;
+}
+
+bool Board::loadFromFEN(std::string_view fen){
+  if(!Position::loadFromFEN(fen)) return false;
+  resetHistory();
+  return true;
+}
+
+//buffer must hold at least FEN_BUFFER_SIZE characters, returns the length written (without the terminator)
+int Position::toFEN(char *buffer) const{
+  char *p = buffer;
+  for(int rank = 7; rank>=0; rank--){
+    int empty = 0;
+    for(int file = 7; file>=0; file--){
+      byte piece = this->piece(rank*8 + file);
+      if(piece == EMPTY){
+        empty++;
+        continue;
+      }
+      if(empty) *p++ = '0'+empty;
+      empty = 0;
+      *p++ = "PBNRQKpbnrqk"[piece];
     }
+    if(empty) *p++ = '0'+empty;
+    if(rank) *p++ = '/';
+  }
+  *p++ = ' ';
+  *p++ = (flags & WHITE_TO_MOVE_BIT) ? 'w' : 'b';
+  *p++ = ' ';
+  if(!(flags & (WHITE_CASTLING_RIGHTS | BLACK_CASTLING_RIGHTS))) *p++ = '-';
+  if(flags & WHITE_KINGSIDE_BIT) *p++ = 'K';
+  if(flags & WHITE_QUEENSIDE_BIT) *p++ = 'Q';
+  if(flags & BLACK_KINGSIDE_BIT) *p++ = 'k';
+  if(flags & BLACK_QUEENSIDE_BIT) *p++ = 'q';
+  *p++ = ' ';
+  if(enPassanTarget == EN_PASSAN_NULL){
+    *p++ = '-';
+  }else{
+    *p++ = 'h' - enPassanTarget%8;
+    *p++ = '1' + enPassanTarget/8;
+  }
+  *p++ = ' ';
+  p = writeNumber(p, halfmoveClock);
+  *p++ = ' ';
+  p = writeNumber(p, fullmoveNumber);
+  *p = '\0';
+  return p-buffer;
+}
+
+void Board::resetHistory(){
+  ply = 0;
+  history[0].hash = key;
+  history[0].pawnHash = pawnKey;
+  history[0].capturedPiece = EMPTY;
+  history[0].attacksValid = false;
+}
+
+//only scans back to the last capture or pawn move, every other position has the other side to move
+bool Board::isRepetition(int count) const{
+  int stop = std::max(0, ply - halfmoveClock);
+  for(int i = ply-4; i>=stop; i -= 2){
+    if(history[i].hash == key && --count == 0) return true;
   }
+  return false;
 }
 
-void Board::makeMove(Move &m){
+byte Position::applyMove(Move m){
   int color = (flags & WHITE_TO_MOVE_BIT) ? WHITE : BLACK;
-  m.setCastlingRights((flags&(0b00011110))>>1);
-  m.setEnPassanTarget(enPassanTarget);
+  if(color == BLACK) fullmoveNumber++;
+  byte castlingRights = flags & (WHITE_CASTLING_RIGHTS | BLACK_CASTLING_RIGHTS);
+  key ^= zobrist::side;
+  if(enPassanTarget != EN_PASSAN_NULL) key ^= zobrist::enPassan[enPassanTarget];
   enPassanTarget = EN_PASSAN_NULL;
-  if(m.isKingside()){
+  byte captured = EMPTY;
+  halfmoveClock++;
+  if(m.isKingside() || m.isQueenside()){
     //this side can no longer castle
     if(color == WHITE) flags &= ~(WHITE_CASTLING_RIGHTS);
     if(color == BLACK) flags &= ~(BLACK_CASTLING_RIGHTS);
-    
-    int offset= (flags & WHITE_TO_MOVE_BIT) ? 0 : 56;
-    //move king
-    resetBit(bitboards[color+KING],3+offset);
-    setBit(bitboards[color+KING],1+offset);
-    squares[3+offset] = EMPTY;
-    squares[1+offset] = color+KING;
-    //move rook
-    resetBit(bitboards[color+ROOK],0+offset);
-    setBit(bitboards[color+ROOK],2+offset);
-    squares[0+offset] = EMPTY;
-    squares[2+offset] = color+ROOK;
 
-    flags ^= WHITE_TO_MOVE_BIT;
-    updateColorBitboards();
-    return;
-  }
-  if(m.isQueenside()){
-    //this side can no longer castle
-    if(color == WHITE) flags &= ~(WHITE_CASTLING_RIGHTS);
-    if(color == BLACK) flags &= ~(BLACK_CASTLING_RIGHTS);
-    
-    int offset= (flags & WHITE_TO_MOVE_BIT) ? 0 : 56;
+    int offset = (color == WHITE) ? 0 : 56;
+    int kingTo = (m.isKingside() ? 1 : 5) + offset;
+    int rookFrom = (m.isKingside() ? 0 : 7) + offset;
+    int rookTo = (m.isKingside() ? 2 : 4) + offset;
     //move king
-    resetBit(bitboards[color+KING],3+offset);
-    setBit(bitboards[color+KING],5+offset);
-    squares[3+offset] = EMPTY;
-    squares[5+offset] = color+KING;
+    clearPiece(3+offset);
+    setPiece(color+KING, kingTo);
     //move rook
-    resetBit(bitboards[color+ROOK],7+offset);
-    setBit(bitboards[color+ROOK],4+offset);
-    squares[7+offset] = EMPTY;
-    squares[4+offset] = color+ROOK;
-
-    flags ^= WHITE_TO_MOVE_BIT;
-    updateColorBitboards();
-    return;
-  }
-
-  byte to = m.getTo();
-  byte from = m.getFrom();
-  if(from < color){
-    //std::cout<<"WRONG COLOR\n";
-  }
-  if(m.isPromotion()){
-    resetBit(bitboards[squares[from]], from);
-    setBit(bitboards[color+m.getPromotionPiece()],from);
-    squares[from] = color+m.getPromotionPiece();
-  }
-  byte fromPiece = squares[from];
-  byte toPiece = squares[to];
-  squares[from] = EMPTY;
-  squares[to] = fromPiece;
-
-  resetBit(bitboards[fromPiece],from);
-  resetBit(bitboards[toPiece],to);
-  setBit(bitboards[fromPiece],to);
-  m.setCapturedPiece(toPiece);//store captured piece (if there is no piece it will just be empty)
-  
-  if(fromPiece == color+KING){
-    if(flags&WHITE_TO_MOVE_BIT){
-      flags &= ~(WHITE_CASTLING_RIGHTS);
-    }else{
-      flags &= ~(BLACK_CASTLING_RIGHTS);
-    }
-  }
-  
-  //update castling rights
-  byte rookSquares[4] = {0,7,56,63};
-  for(int i = 0; i<4; i++){
-    if(from == rookSquares[i] || to == rookSquares[i]){
-      flags &= ~(WHITE_KINGSIDE_BIT<<i);
+    clearPiece(rookFrom);
+    setPiece(color+ROOK, rookTo);
+    key ^= zobrist::pieces[color+KING][3+offset] ^ zobrist::pieces[color+KING][kingTo];
+    key ^= zobrist::pieces[color+ROOK][rookFrom] ^ zobrist::pieces[color+ROOK][rookTo];
+  }else{
+    byte to = m.getTo();
+    byte from = m.getFrom();
+    byte fromPiece = piece(from);
+    key ^= zobrist::pieces[fromPiece][from];
+    bool pawn = fromPiece == color+PAWN;
+    if(pawn){
+      halfmoveClock = 0;
+      pawnKey ^= zobrist::pieces[fromPiece][from];
+      if(!m.isPromotion()) pawnKey ^= zobrist::pieces[fromPiece][to];
     }
-  }
-
-  //do en passan
-  if(m.isEnPassan()){
-    if(flags&WHITE_TO_MOVE_BIT){
-      resetBit(bitboards[BLACK+PAWN],to-8);
-      squares[to-8] = EMPTY;
-    }else{
-      resetBit(bitboards[WHITE+PAWN],to+8);
-      squares[to+8] = EMPTY;
+    if(m.isPromotion()) fromPiece = color+m.getPromotionPiece();
+    captured = piece(to);//kept for unmake (if there is no piece it will just be empty)
+    if(captured != EMPTY){
+      clearPiece(to);
+      key ^= zobrist::pieces[captured][to];
+      if(captured%6 == PAWN) pawnKey ^= zobrist::pieces[captured][to];
+      halfmoveClock = 0;
     }
-  }
-  
-  //Update en passan target
-  if(fromPiece == PAWN || fromPiece == BLACK+PAWN){
-    if(std::abs(to-from)>9){//double forward move
-      enPassanTarget = to;
-      if(flags&WHITE_TO_MOVE_BIT){
-        enPassanTarget -= 8;
+    clearPiece(from);
+    setPiece(fromPiece, to);
+    key ^= zobrist::pieces[fromPiece][to];
+    
+    if(fromPiece == color+KING){
+      if(color == WHITE){
+        flags &= ~(WHITE_CASTLING_RIGHTS);
       }else{
-        enPassanTarget +=8;
+        flags &= ~(BLACK_CASTLING_RIGHTS);
+      }
+    }
+    
+    //update castling rights
+    byte rookSquares[4] = {0,7,56,63};
+    for(int i = 0; i<4; i++){
+      if(from == rookSquares[i] || to == rookSquares[i]){
+        flags &= ~(WHITE_KINGSIDE_BIT<<i);
       }
     }
+
+    //do en passan
+    if(m.isEnPassan()){
+      int victim = (color == WHITE) ? to-8 : to+8;
+      key ^= zobrist::pieces[piece(victim)][victim];
+      pawnKey ^= zobrist::pieces[piece(victim)][victim];
+      clearPiece(victim);
+    }
+    
+    //Update en passan target
+    if(pawn && std::abs(to-from)>9){//double forward move
+      enPassanTarget = (color == WHITE) ? to-8 : to+8;
+      key ^= zobrist::enPassan[enPassanTarget];
+    }
   }
 
+  key ^= zobrist::castling[castlingRights>>1] ^ zobrist::castling[(flags & (WHITE_CASTLING_RIGHTS | BLACK_CASTLING_RIGHTS))>>1];
   flags ^= WHITE_TO_MOVE_BIT;
-  updateColorBitboards();
+  return captured;
 }
 
-void Board::unmakeMove(Move &m){
-  int color = (flags & WHITE_TO_MOVE_BIT) ? BLACK : WHITE;
-  enPassanTarget = m.getEnPassanTarget();
-  if(m.isKingside()){
-    flags ^= WHITE_TO_MOVE_BIT;
-    int offset= (flags & WHITE_TO_MOVE_BIT) ? 0 : 56;
-    //move king
-    setBit(bitboards[color+KING],3+offset);
-    resetBit(bitboards[color+KING],1+offset);
-    squares[1+offset] = EMPTY;
-    squares[3+offset] = color+KING;
-    //move rook
-    setBit(bitboards[color+ROOK],0+offset);
-    resetBit(bitboards[color+ROOK],2+offset);
-    squares[2+offset] = EMPTY;
-    squares[0+offset] = color+ROOK;
+void Board::makeMove(Move m){
+  assert(ply+1 < MAX_GAME_PLY);
+  BoardState &state = history[ply];
+  state.castlingRights = flags & (WHITE_CASTLING_RIGHTS | BLACK_CASTLING_RIGHTS);
+  state.enPassanTarget = enPassanTarget;
+  state.halfmoveClock = halfmoveClock;
+  byte captured = applyMove(m);
+  ply++;
+  history[ply].hash = key;
+  history[ply].pawnHash = pawnKey;
+  history[ply].capturedPiece = captured;
+  history[ply].attacksValid = false;
+}
 
-    flags &= ~(WHITE_CASTLING_RIGHTS  | BLACK_CASTLING_RIGHTS);
-    flags  |= m.getCastlingRights()<<1;
-    updateColorBitboards();
-    return;
-  }
-  if(m.isQueenside()){
-    flags ^= WHITE_TO_MOVE_BIT;
-    int offset= (flags & WHITE_TO_MOVE_BIT) ? 0 : 56;
+//the halfmove clock starts again so repetition checks do not look past the null move
+void Board::makeNullMove(){
+  assert(ply+1 < MAX_GAME_PLY);
+  BoardState &state = history[ply];
+  state.castlingRights = flags & (WHITE_CASTLING_RIGHTS | BLACK_CASTLING_RIGHTS);
+  state.enPassanTarget = enPassanTarget;
+  state.halfmoveClock = halfmoveClock;
+  key ^= zobrist::side;
+  if(enPassanTarget != EN_PASSAN_NULL) key ^= zobrist::enPassan[enPassanTarget];
+  enPassanTarget = EN_PASSAN_NULL;
+  halfmoveClock = 0;
+  flags ^= WHITE_TO_MOVE_BIT;
+  ply++;
+  history[ply].hash = key;
+  history[ply].pawnHash = pawnKey;
+  history[ply].capturedPiece = EMPTY;
+  history[ply].attacksValid = false;
+}
+
+void Board::unmakeNullMove(){
+  ply--;
+  BoardState const &state = history[ply];
+  key = state.hash;
+  pawnKey = state.pawnHash;
+  enPassanTarget = state.enPassanTarget;
+  halfmoveClock = state.halfmoveClock;
+  flags ^= WHITE_TO_MOVE_BIT;
+}
+
+void Board::unmakeMove(Move m){
+  byte captured = history[ply].capturedPiece;
+  ply--;
+  BoardState const &state = history[ply];
+  key = state.hash;
+  pawnKey = state.pawnHash;
+  enPassanTarget = state.enPassanTarget;
+  halfmoveClock = state.halfmoveClock;
+  flags &= ~(WHITE_CASTLING_RIGHTS  | BLACK_CASTLING_RIGHTS);
+  flags |= state.castlingRights;
+  flags ^= WHITE_TO_MOVE_BIT;
+  int color = (flags & WHITE_TO_MOVE_BIT) ? WHITE : BLACK;
+  if(color == BLACK) fullmoveNumber--;
+  if(m.isKingside() || m.isQueenside()){
+    int offset = (color == WHITE) ? 0 : 56;
     //move king
-    setBit(bitboards[color+KING],3+offset);
-    resetBit(bitboards[color+KING],5+offset);
-    squares[5+offset] = EMPTY;
-    squares[3+offset] = color+KING;
+    clearPiece((m.isKingside() ? 1 : 5) + offset);
+    setPiece(color+KING, 3+offset);
     //move rook
-    setBit(bitboards[color+ROOK],7+offset);
-    resetBit(bitboards[color+ROOK],4+offset);
-    squares[4+offset] = EMPTY;
-    squares[7+offset] = color+ROOK;
-
-    flags &= ~(WHITE_CASTLING_RIGHTS  | BLACK_CASTLING_RIGHTS);
-    flags  |= m.getCastlingRights()<<1;
-    updateColorBitboards();
+    clearPiece((m.isKingside() ? 2 : 4) + offset);
+    setPiece(color+ROOK, (m.isKingside() ? 0 : 7) + offset);
     return;
   }
 
   byte to = m.getTo();
   byte from = m.getFrom();
 
-  //if piece was promoted, turn it back to a pawn
-  if(m.isPromotion()){
-    resetBit(bitboards[squares[to]], to);
-    setBit(bitboards[PAWN+color],to);
-    squares[to] = PAWN + color; 
-  }
-  
-  //move piece back
-  byte pieceOnToSquare = squares[to];
-  squares[from] = squares[to];
-  setBit(bitboards[pieceOnToSquare],from);
-  resetBit(bitboards[pieceOnToSquare],to);
-  setBit(bitboards[m.getCapturedPiece()],to);
-  squares[to] = m.getCapturedPiece();
+  //move piece back, if it was promoted, turn it back to a pawn
+  byte piece = m.isPromotion() ? color+PAWN : this->piece(to);
+  clearPiece(to);
+  setPiece(piece, from);
+  if(captured != EMPTY) setPiece(captured, to);
 
   //undo en passan
   if(m.isEnPassan()){
-    if(flags&WHITE_TO_MOVE_BIT){
-      setBit(bitboards[WHITE+PAWN],to+8);
-      squares[to+8] = WHITE+PAWN;
+    if(color == WHITE){
+      setPiece(BLACK+PAWN, to-8);
     }else{
-      setBit(bitboards[BLACK+PAWN],to-8);
-      squares[to-8] = BLACK+PAWN;
+      setPiece(WHITE+PAWN, to+8);
     }
   }
-
-  //restore board state
-  flags &= ~(WHITE_CASTLING_RIGHTS  | BLACK_CASTLING_RIGHTS);
-  flags  |= m.getCastlingRights()<<1;
-  flags ^= WHITE_TO_MOVE_BIT;
-  updateColorBitboards();
-}
\ No newline at end of file
+}
@@ -1,6 +1,7 @@
 #pragma once
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <algorithm>
 #include <cmath>
 
@@ -14,7 +15,6 @@
 #define WHITE_QUEENSIDE_BIT  0b00000100
 #define BLACK_KINGSIDE_BIT   0b00001000
 #define BLACK_QUEENSIDE_BIT  0b00010000
-#define THREATENED_POPULATED 0b00100000
 
 #define WHITE_CASTLING_RIGHTS 0b00000110
 #define BLACK_CASTLING_RIGHTS 0b00011000
@@ -29,8 +29,6 @@
 #define FROM_PIECE_MASK  0b0000001111110000
 
 #define SPECIAL_MOVE_DATA_MASK 0b0000000000001111
-#define EN_PASSAN_TARGET_MASK  0b0000111111000000
-#define CASTLING_RIGHTS_MASK   0b0000000000111100
 
 enum piece{
   PAWN = 0,
@@ -44,21 +42,23 @@ enum piece{
 #define BLACK 6
 #define EMPTY 12
 
+#define FEN_BUFFER_SIZE 96
+#define MAX_GAME_PLY    1024//moves from the loaded position, including the search, games and the search stop short of it
+#define EMPTY_MAILBOX   0xCCCCCCCCCCCCCCCCull//16 EMPTY squares
+
 #define WHITE_PIECES 12
 #define BLACK_PIECES 13
 
 struct Move{
 private:
   unsigned short move = 0; //ttttttffffffssss  t = to f = from s = special move data 
-  unsigned short unmakeData = 0;//cccceeeeeerrrr** c = captured e = en passan r = castling rights * = unused 
 public:
+Move(){}
+explicit Move(unsigned short data) : move(data) {}//from getMoveData, e.g. stored in a file
 inline void setTo(byte to) { move |= to<<10;}
 inline void setFrom(byte from) { move |= from<<4;}
 inline void setSpecialMoveData(byte smd) { move |= smd;}
 inline void setPromotion(byte piece) {move |= piece | PROMOTION_BIT;}
-inline void setEnPassanTarget(byte target){ unmakeData |= target<<6;}
-inline void setCastlingRights(byte flags){unmakeData |= flags<<2;}
-inline void setCapturedPiece(byte piece){unmakeData |= piece<<12;}
 
 inline byte getTo() {return (move & TO_PIECE_MASK)>>10;}
 inline byte getFrom() {return (move & FROM_PIECE_MASK)>>4;}
@@ -69,30 +69,91 @@ inline bool isQueenside(){ return getSpecialMoveData() == CASTLE_QUEENSIDE;}
 inline bool isPromotion(){return move & PROMOTION_BIT;}
 inline byte getPromotionPiece(){return move & PROMOTION_MASK;}
 
+unsigned short getMoveData() const {return move;}
+};
 
-inline byte getEnPassanTarget(){ return (unmakeData & EN_PASSAN_TARGET_MASK )>>6;}
-inline byte getCastlingRights(){return (unmakeData & CASTLING_RIGHTS_MASK)>>2;}
-inline byte getCapturedPiece(){return unmakeData>>12;}
+//attack information for the side to move, computed by Search
+struct AttackInfo{
+  u64 attacked;//squares the other side attacks, seen through the king
+  u64 checkers;//pieces giving check
+  u64 pinned;//own pieces pinned to the king
+};
 
-unsigned short getUnmakeData(){return unmakeData;}
-unsigned short getMoveData(){return move;}
-inline void resetUnmakeData(){unmakeData = (unsigned short)0;}
+//what unmakeMove needs to restore a position, plus its hash for repetition checks
+//history[ply] is the current position, capturedPiece is the piece taken by the move that led to it
+struct BoardState{
+  u64 hash;
+  u64 pawnHash;
+  unsigned short halfmoveClock;
+  byte castlingRights;//flag bits
+  byte enPassanTarget;
+  byte capturedPiece;
+  bool attacksValid;//attacks is filled lazily, once per ply
+  AttackInfo attacks;
 };
 
 int getSquareIndex(int file, int rank);
 
-struct Board{
-  u64 bitboards[14];
-  u64 occupancy; 
-  u64 threatened[2]; // squares threatened by white come first
-  byte enPassanTarget = EN_PASSAN_NULL;
-  byte squares[64];
+//Compact position, two cache lines so copy-make can copy it whole
+//pieces are stored once per type and once per color, the mailbox packs 4 bits per square
+struct alignas(64) Position{
+  u64 pieceBitboards[6];//both colors, indexed by piece type
+  u64 colorBitboards[2];//white first
+  u64 mailbox[4] = {EMPTY_MAILBOX, EMPTY_MAILBOX, EMPTY_MAILBOX, EMPTY_MAILBOX};
+  u64 key = 0;//zobrist key, updated by applyMove
+  u64 pawnKey = 0;//zobrist key of the pawns alone, for the pawn hash table
   byte flags = 0 | WHITE_TO_MOVE_BIT;
-  
-  void makeMove(Move &m);
-  void unmakeMove(Move &m);
-  void loadFromFEN(std::string fen);
-  void updateColorBitboards();
-
+  byte enPassanTarget = EN_PASSAN_NULL;
+  unsigned short halfmoveClock = 0;
+  unsigned short fullmoveNumber = 1;
+
+  //piece is a color+type, or WHITE_PIECES/BLACK_PIECES for a whole side
+  inline u64 bitboard(int piece) const{
+    if(piece >= WHITE_PIECES) return colorBitboards[piece-WHITE_PIECES];
+    return pieceBitboards[piece%6] & colorBitboards[piece/6];
+  }
+  inline u64 occupancy() const {return colorBitboards[0] | colorBitboards[1];}
+  inline byte piece(int square) const {return (mailbox[square>>4] >> ((square&15)<<2)) & 15;}
+  inline void setPiece(byte piece, int square){
+    u64 b = (u64)1<<square;
+    pieceBitboards[piece%6] |= b;
+    colorBitboards[piece/6] |= b;
+    int shift = (square&15)<<2;
+    mailbox[square>>4] = (mailbox[square>>4] & ~((u64)15<<shift)) | ((u64)piece<<shift);
+  }
+  inline void clearPiece(int square){
+    byte p = piece(square);
+    if(p == EMPTY) return;
+    u64 b = ~((u64)1<<square);
+    pieceBitboards[p%6] &= b;
+    colorBitboards[p/6] &= b;
+    int shift = (square&15)<<2;
+    mailbox[square>>4] = (mailbox[square>>4] & ~((u64)15<<shift)) | ((u64)EMPTY<<shift);
+  }
+
+  byte applyMove(Move m);//plays m without keeping undo data, returns the captured piece
+  bool loadFromFEN(std::string_view fen);//false if the fen is malformed
+  int toFEN(char *buffer) const;//buffer needs FEN_BUFFER_SIZE characters
+  u64 hash() const {return key;}
+  u64 pawnHash() const {return pawnKey;}
+  u64 computeHash() const;//from scratch
+  u64 computePawnHash() const;
   bool validate() const;//checks if the position is valid
 };
+static_assert(sizeof(Position) == 128, "Position should fill exactly two cache lines");
+
+//Position plus the history needed for unmakeMove and repetition checks
+struct Board : Position{
+  int ply = 0;//moves made since the position was loaded
+  BoardState history[MAX_GAME_PLY] = {};
+  
+  void makeMove(Move m);
+  void unmakeMove(Move m);
+  //passes the turn, only the side to move and en passan change, used by null move pruning in the search
+  void makeNullMove();
+  void unmakeNullMove();
+  void resetHistory();//call after setting up a position by hand, the loaded position becomes ply 0
+  bool isRepetition(int count = 1) const;//the position occurred count times before, since the last irreversible move
+  bool isFiftyMoveDraw() const {return halfmoveClock >= 100;}
+  bool loadFromFEN(std::string_view fen);//false if the fen is malformed
+};
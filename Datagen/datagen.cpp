@@ -0,0 +1,129 @@
+#include "datagen.h"
+#include <cstdio>
+
+namespace {
+u64 nextRandom(u64 &state){
+  state ^= state>>12;
+  state ^= state<<25;
+  state ^= state>>27;
+  return state * 0x2545F4914F6CDD1Dull;
+}
+}
+
+DataGenerator::DataGenerator(Search const &search, DatagenOptions options) : options(options), search(search){
+  if(this->options.threads <= 0) this->options.threads = std::max(1u, std::thread::hardware_concurrency());
+}
+
+std::string DataGenerator::chunkName(int thread){
+  return options.output + ".chunk" + std::to_string(thread);
+}
+
+bool DataGenerator::run(){
+  std::cout<<"[generating "<<options.games<<" games on "<<options.threads<<" threads]"<<std::endl;
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> pool;
+  for(int t = 0; t<options.threads; t++){
+    pool.emplace_back(&DataGenerator::work, this, t);
+  }
+  u64 lastGames = 0;
+  while(true){
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    u64 games = std::min(gamesStarted.load(), options.games);
+    bool done = gamesStarted.load() >= options.games + options.threads;//every thread has taken its last ticket
+    if(games/100 != lastGames/100 || done){
+      u64 ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now()-start).count();
+      std::cout<<"games "<<games<<" positions "<<positionsWritten.load();
+      std::cout<<" ("<<positionsWritten.load()*1000/(ms ? ms : 1)<<" positions/s)"<<std::endl;
+      lastGames = games;
+    }
+    if(done) break;
+  }
+  for(std::thread &t : pool) t.join();
+  u64 ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now()-start).count();
+
+  //merge chunks, dropping positions another thread already wrote
+  std::ofstream out(options.output + ".tmp", std::ofstream::out | std::ofstream::trunc | std::ofstream::binary);
+  if(!out.is_open()){
+    std::cout<<"[error] Could not open "<<options.output<<".tmp"<<std::endl;
+    return false;
+  }
+  std::unordered_set<u64> seen;
+  u64 merged = 0;
+  for(int t = 0; t<options.threads; t++){
+    std::ifstream in(chunkName(t), std::ifstream::binary);
+    ChunkRecord chunked;
+    while(in.read((char *)&chunked, sizeof(chunked))){
+      if(!seen.insert(chunked.hash).second) continue;
+      out.write((char const *)&chunked.record, sizeof(chunked.record));
+      merged++;
+    }
+    in.close();
+    std::remove(chunkName(t).c_str());
+  }
+  out.close();
+  if(out.fail() || std::rename((options.output + ".tmp").c_str(), options.output.c_str()) != 0){
+    std::cout<<"[error] Could not write "<<options.output<<std::endl;
+    return false;
+  }
+  std::cout<<"Generated "<<positionsWritten.load()<<" positions in "<<(float)ms/1000.f<<"s";
+  std::cout<<" ("<<positionsWritten.load()*1000/(ms ? ms : 1)<<" positions/s)\n";
+  std::cout<<"Wrote "<<merged<<" unique positions ("<<merged*sizeof(TrainingRecord)<<" bytes) to "<<options.output<<std::endl;
+  return true;
+}
+
+void DataGenerator::work(int thread){
+  Search localSearch = search;//shares the slider tables
+  localSearch.book = nullptr;//book moves come back unsearched with a score of 0
+  Board board;
+  u64 random = options.seed*0x9E3779B97F4A7C15ull + thread + 1;
+  std::ofstream chunk(chunkName(thread), std::ofstream::out | std::ofstream::trunc | std::ofstream::binary);
+  std::vector<char> buffer(1<<20);
+  chunk.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+  std::unordered_set<u64> seen;//duplicates inside this thread never reach the chunk
+  std::vector<ChunkRecord> game;
+  while(gamesStarted++ < options.games){
+    playGame(board, localSearch, random, game);
+    for(ChunkRecord const &chunked : game){
+      if(!seen.insert(chunked.hash).second) continue;
+      chunk.write((char const *)&chunked, sizeof(chunked));
+      positionsWritten++;
+    }
+  }
+  chunk.close();
+}
+
+void DataGenerator::playGame(Board &board, Search &localSearch, u64 &random, std::vector<ChunkRecord> &game){
+  game.clear();
+  board.loadFromFEN("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+  MoveList moves;
+  for(int ply = 0; ply<options.randomPlies; ply++){
+    localSearch.generateMoves(board, moves);
+    if(moves.end == 0) break;
+    Move m = moves.moves[nextRandom(random)%moves.end];
+    board.makeMove(m);
+  }
+  signed char result = 0;
+  for(int ply = 0; ply<options.maxPlies && board.ply<MAX_ROOT_PLY; ply++){
+    localSearch.generateMoves(board, moves);
+    if(moves.end == 0){
+      if(localSearch.inCheck(board)) result = (board.flags & WHITE_TO_MOVE_BIT) ? -1 : 1;
+      break;
+    }
+    if(popcount(board.occupancy()) == 2) break;//bare kings
+    if(board.isRepetition(2) || board.isFiftyMoveDraw()) break;
+    int score;
+    Move m = localSearch.searchBestMove(board, options.depth, options.nodes, score);
+    bool white = board.flags & WHITE_TO_MOVE_BIT;
+    //positions in check or with a mate score are poor training targets
+    if(!localSearch.inCheck(board) && std::abs(score) < MATE_SCORE - 1000){
+      ChunkRecord chunked;
+      chunked.record.position.encode(board);
+      chunked.record.score = white ? score : -score;
+      chunked.record.move = m.getMoveData();
+      chunked.hash = board.hash();
+      game.push_back(chunked);
+    }
+    board.makeMove(m);
+  }
+  for(ChunkRecord &chunked : game) chunked.record.result = result;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <atomic>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "../Board/board.h"
+#include "../Board/Packed/packed.h"
+#include "../Search/search.h"
+
+//one position of a self play game
+struct TrainingRecord{
+  PackedBoard position;
+  short score;//centipawns from white's point of view
+  unsigned short move;//Move::getMoveData of the move played
+  signed char result;//1 white won, 0 draw, -1 black won
+  byte reserved[3] = {};
+};
+static_assert(sizeof(TrainingRecord) == 40, "TrainingRecord must stay 40 bytes");
+
+//what the chunk files hold, the hash of the position is kept so the merge never decodes it again
+struct ChunkRecord{
+  TrainingRecord record;
+  u64 hash;
+};
+
+struct DatagenOptions{
+  std::string output;
+  u64 games = 100;
+  int depth = 6;//maximum depth per move
+  u64 nodes = 0;//node budget per move, 0 is no limit
+  int threads = 0;//0 uses every core
+  int randomPlies = 8;//random moves at the start of every game
+  int maxPlies = 400;//games this long are scored as draws, never more than MAX_ROOT_PLY
+  u64 seed = 1;
+};
+
+//Plays self play games on every thread, each thread writes its records to its own chunk file
+//Chunks are merged into the output at the end, positions already seen (by hash) are dropped
+class DataGenerator{
+  DatagenOptions options;
+  Search const &search;
+  std::atomic<u64> gamesStarted{0};
+  std::atomic<u64> positionsWritten{0};
+
+  void work(int thread);
+  void playGame(Board &board, Search &localSearch, u64 &random, std::vector<ChunkRecord> &game);
+  std::string chunkName(int thread);
+public:
+  DataGenerator(Search const &search, DatagenOptions options);
+  bool run();
+};
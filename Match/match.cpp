@@ -0,0 +1,318 @@
+#include "match.h"
+#include <cmath>
+
+namespace{
+u64 nextRandom(u64 &state){
+  state ^= state>>12;
+  state ^= state<<25;
+  state ^= state>>27;
+  return state * 0x2545F4914F6CDD1Dull;
+}
+
+std::string squareName(int square){
+  return std::string(1, 'h'-square%8) + std::string(1, '1'+square/8);
+}
+
+//expected score of a player this much stronger
+double eloScore(double elo){
+  return 1.0/(1.0 + std::pow(10.0, -elo/400.0));
+}
+
+//to places decimals, without printing -0
+double rounded(double value, int places){
+  double scale = std::pow(10.0, places);
+  double r = std::round(value*scale)/scale;
+  return r == 0 ? 0 : r;
+}
+
+double scoreElo(double score){
+  score = std::min(std::max(score, 1e-6), 1-1e-6);
+  return -400.0*std::log10(1.0/score - 1.0);
+}
+}
+
+bool parseEngineConfig(std::string const &spec, EngineConfig &config){
+  for(size_t start = 0, end; start < spec.size(); start = end+1){
+    end = spec.find(',', start);
+    if(end == std::string::npos) end = spec.size();
+    std::string item = spec.substr(start, end-start);
+    size_t equals = item.find('=');
+    std::string key = item.substr(0, equals);
+    std::string value = equals == std::string::npos ? "" : item.substr(equals+1);
+    if(key == "name") config.name = value;
+    else if(key == "depth") config.depth = std::stoi(value);
+    else if(key == "nodes") config.nodes = std::stoull(value);
+    else if(key == "disable"){
+      for(size_t s = 0, e; s <= value.size(); s = e+1){
+        e = value.find('+', s);
+        if(e == std::string::npos) e = value.size();
+        if(e > s && !config.features.set(value.substr(s, e-s), false)){
+          std::cout<<"[error] Unknown search feature "<<value.substr(s, e-s)<<", expected pvs, nmp, lmr, rfp, futility, razoring or checkext"<<std::endl;
+          return false;
+        }
+      }
+    }else if(!key.empty()){
+      std::cout<<"[error] Unknown engine setting "<<key<<", expected name, depth, nodes or disable"<<std::endl;
+      return false;
+    }
+  }
+  if(config.name.empty()) config.name = spec.empty() ? "default" : spec;
+  return true;
+}
+
+bool PgnWriter::open(std::string const &path){
+  out.open(path, std::ofstream::out | std::ofstream::trunc);
+  if(!out.is_open()){
+    std::cout<<"[error] Could not open "<<path<<std::endl;
+    return false;
+  }
+  return true;
+}
+
+void PgnWriter::write(std::string const &game){
+  std::lock_guard<std::mutex> guard(lock);
+  buffer += game;
+  if(buffer.size() >= PGN_BUFFER_SIZE && out.is_open()){
+    out<<buffer;
+    buffer.clear();
+  }
+}
+
+void PgnWriter::flush(){
+  std::lock_guard<std::mutex> guard(lock);
+  if(out.is_open()){
+    out<<buffer;
+    out.flush();
+  }
+  buffer.clear();
+}
+
+std::string moveToSan(Search &search, Position const &board, Move move){
+  std::string san;
+  if(move.isKingside()) san = "O-O";
+  else if(move.isQueenside()) san = "O-O-O";
+  else{
+    int from = move.getFrom(), to = move.getTo();
+    int piece = board.piece(from)%6;
+    bool capture = board.piece(to) != EMPTY || move.isEnPassan();
+    if(piece == PAWN){
+      if(capture) san += std::string(1, 'h'-from%8) + "x";
+      san += squareName(to);
+      if(move.isPromotion()) san += std::string("=") + "PBNRQK"[move.getPromotionPiece()%6];
+    }else{
+      san += "PBNRQK"[piece];
+      //another piece of the same kind that can reach the square decides what is added
+      MoveList moves;
+      search.generateMoves(board, moves);
+      bool ambiguous = false, sameFile = false, sameRank = false;
+      for(int i = 0; i<moves.end; i++){
+        Move other = moves.moves[i];
+        if(other.isKingside() || other.isQueenside() || other.getTo() != to || other.getFrom() == from) continue;
+        if(board.piece(other.getFrom())%6 != piece) continue;
+        ambiguous = true;
+        sameFile |= other.getFrom()%8 == from%8;
+        sameRank |= other.getFrom()/8 == from/8;
+      }
+      if(ambiguous && (!sameFile || sameRank)) san += std::string(1, 'h'-from%8);
+      if(ambiguous && sameFile) san += std::string(1, '1'+from/8);
+      if(capture) san += "x";
+      san += squareName(to);
+    }
+  }
+  Position after = board;//a copy, so the board history is never written
+  after.applyMove(move);
+  if(search.inCheck(after)){
+    MoveList replies;
+    search.generateMoves(after, replies);
+    san += replies.end == 0 ? "#" : "+";
+  }
+  return san;
+}
+
+MatchRunner::MatchRunner(Search const &search, MatchOptions options) : options(options), search(search){
+  if(this->options.threads <= 0) this->options.threads = std::max(1u, std::thread::hardware_concurrency());
+}
+
+//a pair of games shares its opening, from the list or random moves seeded by the pair
+std::string MatchRunner::opening(Search &localSearch, Board &board, u64 pair){
+  if(!openings.empty()) return openings[pair % openings.size()];
+  board.loadFromFEN("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+  u64 random = options.seed*0x9E3779B97F4A7C15ull + pair + 1;
+  MoveList moves;
+  for(int ply = 0; ply<options.randomPlies; ply++){
+    localSearch.generateMoves(board, moves);
+    if(moves.end == 0) break;
+    board.makeMove(moves.moves[nextRandom(random)%moves.end]);
+  }
+  char fen[FEN_BUFFER_SIZE];
+  board.toFEN(fen);
+  return fen;
+}
+
+bool MatchRunner::run(){
+  if(options.openings != ""){
+    std::ifstream in(options.openings);
+    if(!in.is_open()){
+      std::cout<<"[error] Could not open "<<options.openings<<std::endl;
+      return false;
+    }
+    Board board;
+    std::string line;
+    while(std::getline(in, line)){
+      if(line.empty()) continue;
+      if(!board.loadFromFEN(line)){
+        std::cout<<"[warning] Skipping opening "<<line<<std::endl;
+        continue;
+      }
+      char fen[FEN_BUFFER_SIZE];
+      board.toFEN(fen);
+      openings.push_back(fen);
+    }
+    if(openings.empty()){
+      std::cout<<"[error] No openings in "<<options.openings<<std::endl;
+      return false;
+    }
+  }
+  if(options.pgn != "" && !pgn.open(options.pgn)) return false;
+  std::cout<<"[playing "<<options.games<<" games of "<<options.engines[0].name<<" against "<<options.engines[1].name;
+  std::cout<<" on "<<options.threads<<" threads, sprt elo0 "<<options.elo0<<" elo1 "<<options.elo1<<"]"<<std::endl;
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> pool;
+  for(int t = 0; t<options.threads; t++){
+    pool.emplace_back(&MatchRunner::work, this);
+  }
+  u64 lastReported = 0;
+  while(true){
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    u64 done;
+    {
+      std::lock_guard<std::mutex> guard(statsLock);
+      done = finished;
+    }
+    bool over = done >= std::min(gamesStarted.load(), options.games) && (stopping || done >= options.games);
+    if(done/MATCH_REPORT_GAMES != lastReported/MATCH_REPORT_GAMES && !over){
+      report(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now()-start).count());
+      lastReported = done;
+    }
+    if(over) break;
+  }
+  for(std::thread &t : pool) t.join();
+  pgn.flush();
+  report(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now()-start).count());
+  double ratio = llr();
+  double lower = std::log(options.beta/(1-options.alpha)), upper = std::log((1-options.beta)/options.alpha);
+  if(ratio >= upper) std::cout<<"SPRT accepted H1: "<<options.engines[0].name<<" is at least "<<options.elo1<<" elo stronger"<<std::endl;
+  else if(ratio <= lower) std::cout<<"SPRT accepted H0: "<<options.engines[0].name<<" is not more than "<<options.elo0<<" elo stronger"<<std::endl;
+  else std::cout<<"SPRT inconclusive"<<std::endl;
+  if(options.pgn != "") std::cout<<"Wrote the games to "<<options.pgn<<std::endl;
+  return true;
+}
+
+void MatchRunner::work(){
+  Search localSearches[2] = {search, search};//share the slider tables
+  Search *engines[2];
+  for(int e = 0; e<2; e++){
+    localSearches[e].features = options.engines[e].features;
+    localSearches[e].tt = std::make_shared<TranspositionTable>(options.hashMegabytes);
+    localSearches[e].book = nullptr;
+    localSearches[e].positionCache = nullptr;//would carry results from one engine to the other
+    engines[e] = &localSearches[e];
+  }
+  Board board;
+  u64 game;
+  while(!stopping && (game = gamesStarted++) < options.games){
+    bool swapped = game%2;//odd games give the first engine black
+    std::string fen = opening(*engines[0], board, game/2);
+    std::string moves, reason;
+    for(Search *engine : engines) engine->tt->clear();
+    Search *players[2] = {engines[swapped], engines[!swapped]};//white, black
+    int result = playGame(board, players, fen, swapped, moves, reason);
+    record(swapped ? -result : result);
+    if(options.pgn == "") continue;
+    std::string text = "[Event \"match\"]\n[Site \"local\"]\n[Round \"" + std::to_string(game+1) + "\"]\n";
+    text += "[White \"" + options.engines[swapped].name + "\"]\n[Black \"" + options.engines[!swapped].name + "\"]\n";
+    std::string resultText = result > 0 ? "1-0" : result < 0 ? "0-1" : "1/2-1/2";
+    text += "[Result \"" + resultText + "\"]\n[SetUp \"1\"]\n[FEN \"" + fen + "\"]\n\n";
+    text += moves + "{" + reason + "} " + resultText + "\n\n";
+    pgn.write(text);
+  }
+}
+
+//result from white's side, moves is the pgn movetext wrapped at 80 columns
+int MatchRunner::playGame(Board &board, Search *engines[2], std::string const &fen, bool swapped, std::string &moves, std::string &reason){
+  board.loadFromFEN(fen);
+  moves.clear();
+  size_t lineStart = 0;
+  MoveList legal;
+  for(int ply = 0; ply<options.maxPlies && board.ply<MAX_ROOT_PLY; ply++){
+    bool white = board.flags & WHITE_TO_MOVE_BIT;
+    engines[0]->generateMoves(board, legal);
+    if(legal.end == 0){
+      if(!engines[0]->inCheck(board)){
+        reason = "Stalemate";
+        return 0;
+      }
+      reason = white ? "Black mates" : "White mates";
+      return white ? -1 : 1;
+    }
+    if(board.isRepetition(2)){
+      reason = "Threefold repetition";
+      return 0;
+    }
+    if(board.isFiftyMoveDraw()){
+      reason = "Fifty move rule";
+      return 0;
+    }
+    EngineConfig const &config = options.engines[white ? swapped : !swapped];
+    int score;
+    Move m = engines[!white]->searchBestMove(board, config.depth, config.nodes, score);
+    std::string token = "";
+    if(white) token = std::to_string(board.fullmoveNumber) + ". ";
+    else if(ply == 0) token = std::to_string(board.fullmoveNumber) + "... ";
+    token += moveToSan(*engines[!white], board, m) + " ";
+    if(moves.size() - lineStart + token.size() > 80){
+      moves.back() = '\n';
+      lineStart = moves.size();
+    }
+    moves += token;
+    board.makeMove(m);
+  }
+  reason = "Maximum length";
+  return 0;
+}
+
+void MatchRunner::record(int score){
+  std::lock_guard<std::mutex> guard(statsLock);
+  results[score+1]++;
+  finished++;
+  double ratio = llr();
+  if(ratio >= std::log((1-options.beta)/options.alpha) || ratio <= std::log(options.beta/(1-options.alpha))) stopping = true;
+}
+
+//the generalized sprt approximation for a trinomial (loss, draw, win) score, from the first engine's side
+double MatchRunner::llr(){
+  u64 n = results[0] + results[1] + results[2];
+  if(n == 0 || results[1] == n) return 0;
+  double score = (results[2] + 0.5*results[1])/n;
+  double variance = (results[2]*(1-score)*(1-score) + results[1]*(0.5-score)*(0.5-score) + results[0]*score*score)/n;
+  if(variance <= 0) return 0;
+  double s0 = eloScore(options.elo0), s1 = eloScore(options.elo1);
+  return n*(s1-s0)*(2*score-s0-s1)/(2*variance);
+}
+
+//elo with a 95% interval from the standard error of the mean score
+void MatchRunner::report(u64 ms){
+  std::lock_guard<std::mutex> guard(statsLock);
+  u64 n = finished;
+  if(n == 0) return;
+  double score = (results[2] + 0.5*results[1])/n;
+  double variance = (results[2]*(1-score)*(1-score) + results[1]*(0.5-score)*(0.5-score) + results[0]*score*score)/n;
+  double margin = 1.96*std::sqrt(variance/n);
+  double elo = scoreElo(score);
+  double error = (scoreElo(std::min(score+margin, 1.0)) - scoreElo(std::max(score-margin, 0.0)))/2;
+  double lower = std::log(options.beta/(1-options.alpha)), upper = std::log((1-options.beta)/options.alpha);
+  double minutes = ms/60000.0;
+  std::cout<<"games "<<n<<" +"<<results[2]<<" ="<<results[1]<<" -"<<results[0]<<" elo "<<rounded(elo, 1)<<" +- "<<rounded(error, 1);
+  std::cout<<" llr "<<rounded(llr(), 2)<<" ("<<rounded(lower, 2)<<", "<<rounded(upper, 2)<<")";
+  std::cout<<" "<<rounded(minutes > 0 ? n/minutes : 0, 1)<<" games/min"<<std::endl;
+}
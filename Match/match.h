@@ -0,0 +1,80 @@
+#pragma once
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../Board/board.h"
+#include "../Search/search.h"
+
+#define MATCH_REPORT_GAMES 50//a progress line every this many finished games
+#define PGN_BUFFER_SIZE (1<<16)//bytes of games kept before they are written
+
+//one side of a match, written as comma separated key=value pairs, e.g. "name=lmr,nodes=20000,disable=lmr+nmp"
+struct EngineConfig{
+  std::string name;
+  int depth = 20;
+  u64 nodes = 10000;//per move, 0 is no limit
+  SearchFeatures features;
+};
+bool parseEngineConfig(std::string const &spec, EngineConfig &config);//false with an [error] when a key is unknown
+
+struct MatchOptions{
+  EngineConfig engines[2];
+  u64 games = 100;
+  int threads = 0;//0 uses every core
+  std::string openings;//a fen or epd per line, each is played twice with colors swapped, random openings when empty
+  std::string pgn;//no pgn is written when empty
+  int hashMegabytes = 8;//per engine per thread
+  int randomPlies = 8;//random openings are this many random moves from the start position
+  int maxPlies = 400;//longer games are drawn, never more than MAX_ROOT_PLY
+  u64 seed = 1;
+  //sprt of elo1 against elo0, for the first engine
+  double elo0 = 0;
+  double elo1 = 5;
+  double alpha = 0.05;
+  double beta = 0.05;
+};
+
+//games are appended under one lock and written a buffer at a time, so the threads never wait on the disk
+class PgnWriter{
+  std::ofstream out;
+  std::string buffer;
+  std::mutex lock;
+public:
+  bool open(std::string const &path);
+  void write(std::string const &game);
+  void flush();
+  ~PgnWriter(){flush();}
+};
+
+//short algebraic notation, board is the position before the move, the move must be legal
+std::string moveToSan(Search &search, Position const &board, Move move);
+
+//Plays the two engines against each other on every thread, each game has its own Board and each thread its own two Search copies
+//Games end in mate, stalemate, threefold repetition, the fifty move rule or at maxPlies, scores are from the first engine's side
+//After every game the Elo estimate and the SPRT log likelihood ratio are updated, the match stops early once the SPRT accepts either hypothesis
+class MatchRunner{
+  MatchOptions options;
+  Search const &search;
+  std::vector<std::string> openings;
+  PgnWriter pgn;
+  std::atomic<u64> gamesStarted{0};
+  std::atomic<bool> stopping{false};
+
+  std::mutex statsLock;
+  u64 results[3] = {};//losses, draws and wins of the first engine
+  u64 finished = 0;
+
+  void work();
+  std::string opening(Search &localSearch, Board &board, u64 pair);
+  int playGame(Board &board, Search *engines[2], std::string const &fen, bool swapped, std::string &moves, std::string &reason);
+  void record(int score);//1 first engine won, 0 draw, -1 lost
+  void report(u64 ms);
+  double llr();
+public:
+  MatchRunner(Search const &search, MatchOptions options);
+  bool run();
+};
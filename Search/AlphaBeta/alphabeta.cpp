@@ -0,0 +1,334 @@
+#include "../search.h"
+#include <array>
+
+//selective search margins, in centipawns per ply of remaining depth
+#define RFP_MAX_DEPTH          6
+#define RFP_MARGIN             90
+#define RAZOR_MAX_DEPTH        3
+#define RAZOR_MARGIN           250
+#define FUTILITY_MAX_DEPTH     3
+#define FUTILITY_MARGIN        150
+#define NULL_MOVE_MIN_DEPTH    3
+#define NULL_MOVE_VERIFY_DEPTH 7//shallower null move cutoffs are trusted
+#define LMR_MIN_DEPTH          3
+#define LMR_MIN_MOVES          3//the hash move and the best captures are never reduced
+
+namespace{
+//grows with the log of both the depth and the number of moves searched before it
+int lateMoveReduction(int depth, int searched){
+  static const auto table = []{
+    std::array<std::array<byte, 64>, 64> t{};
+    for(int d = 1; d<64; d++){
+      for(int m = 1; m<64; m++) t[d][m] = 0.75 + std::log(d)*std::log(m)/2.25;
+    }
+    return t;
+  }();
+  return table[std::min(depth, 63)][std::min(searched, 63)];
+}
+
+//progress in a bitbase win, for the side that wins: the losing king pushed to the edge and the kings close together
+int mopUp(Position const &board, int winner){
+  int winning = lsb(board.bitboard(winner+KING)), losing = lsb(board.bitboard((winner == WHITE ? BLACK : WHITE)+KING));
+  auto centerDistance = [](int square){return std::max(std::abs(2*(square%8)-7), std::abs(2*(square/8)-7))/2;};
+  int kingDistance = std::max(std::abs(winning%8-losing%8), std::abs(winning/8-losing/8));
+  return 40*centerDistance(losing) + 30*(7-kingDistance);
+}
+}
+
+bool Search::isCapture(Position const &board, Move m){
+  if(m.isKingside() || m.isQueenside()) return false;
+  return board.piece(m.getTo()) != EMPTY || m.isEnPassan() || m.isPromotion();
+}
+
+//captures first, most valuable victim then least valuable attacker
+short Search::moveScore(Position const &board, Move m){
+  if(!isCapture(board, m)) return 0;
+  short score = 10000 + pieceValue(board.piece(m.getTo()))*10 - pieceValue(board.piece(m.getFrom()))/10;
+  if(m.isPromotion()) score += pieceValue(m.getPromotionPiece());
+  return score;
+}
+
+//generates into the move arena, then scores into this ply's slice and sorts it (stable, best first)
+//the hash move goes before everything else
+void Search::generateOrderedMoves(Board &board, PlyMoves<ScoredMove> &moves, Move hashMove){
+  {
+    PlyMoves<Move> generated(moveArena);
+    generated.end = generateMoves(board, attackInfo(board), generated.begin);
+    for(Move *m = generated.begin; m != generated.end; m++){
+      moves.end->move = *m;
+      moves.end->score = m->getMoveData() == hashMove.getMoveData() ? 30000 : moveScore(board, *m);
+      moves.end++;
+    }
+  }
+  moves.claim();
+  for(ScoredMove *i = moves.begin+1; i < moves.end; i++){
+    ScoredMove m = *i;
+    ScoredMove *j = i;
+    while(j > moves.begin && (j-1)->score < m.score){
+      *j = *(j-1);
+      j--;
+    }
+    *j = m;
+  }
+}
+
+//trackPV keeps the line of captures in pvTable, only the tuner's quietLine needs it
+int Search::quiescence(Board &board, int alpha, int beta, int ply, bool trackPV){
+  nodes++;
+  if(trackPV) pvLength[ply] = ply;
+  if(nodeLimit && nodes >= nodeLimit) stopped = true;
+  if(stopped) return 0;
+  int standPat = evaluate(board);
+  if(standPat >= beta || board.ply >= MAX_GAME_PLY-1) return standPat;//a full history takes no more moves
+  if(standPat > alpha) alpha = standPat;
+  PlyMoves<ScoredMove> moves(scoredArena);
+  generateOrderedMoves(board, moves);
+  if(moves.size() == 0) return inCheck(board) ? -MATE_SCORE + ply : 0;
+  for(ScoredMove *m = moves.begin; m != moves.end; m++){
+    if(m->score == 0) break;//captures are ordered first
+    board.makeMove(m->move);
+    int score = -quiescence(board, -beta, -alpha, ply+1, trackPV);
+    board.unmakeMove(m->move);
+    if(score >= beta) return score;
+    if(score > alpha){
+      alpha = score;
+      if(trackPV) updatePV(ply, m->move);
+    }
+  }
+  return alpha;
+}
+
+std::vector<Move> Search::quietLine(Board &board){
+  nodeLimit = 0;
+  stopped = false;
+  quiescence(board, -INFINITE_SCORE, INFINITE_SCORE, 0, true);
+  return principalVariation();
+}
+
+//the child's line with m in front of it
+void Search::updatePV(int ply, Move m){
+  pvTable[ply][ply] = m;
+  for(int i = ply+1; i<pvLength[ply+1]; i++) pvTable[ply][i] = pvTable[ply+1][i];
+  pvLength[ply] = pvLength[ply+1];
+}
+
+int Search::alphaBeta(Board &board, int depth, int alpha, int beta, int ply, bool allowNull){
+  pvLength[ply] = ply;
+  if(ply >= MAX_SEARCH_PLY-1 || board.ply >= MAX_GAME_PLY-HISTORY_MARGIN) return quiescence(board, alpha, beta, ply);
+  bool checked = inCheck(board);//the attack info is cached, move generation uses it anyway
+  if(checked && features.checkExtensions) depth++;
+  if(depth <= 0) return quiescence(board, alpha, beta, ply);
+  nodes++;
+  if(nodeLimit && nodes >= nodeLimit) stopped = true;
+  if(stopped) return 0;
+  if(board.isRepetition() || board.isFiftyMoveDraw()) return 0;
+  //a bitbase result is a bound, not a score: a win is worth at least KNOWN_WIN (plus eval and mop up so the search still makes progress)
+  //and the search goes on when the window is above it, so mates are still found and played
+  int bitbaseFloor = -INFINITE_SCORE, bitbaseCeiling = INFINITE_SCORE;
+  if(bitbases && ply > 0 && popcount(board.bitboard(WHITE_PIECES) | board.bitboard(BLACK_PIECES)) <= 4){
+    int result = bitbases->probe(board);
+    if(result == BITBASE_DRAW) return 0;//no mate or stalemate is a draw with moves left, and a stalemate scores 0 anyway
+    if(result == BITBASE_WIN){
+      bitbaseFloor = KNOWN_WIN + evaluate(board) + mopUp(board, (board.flags & WHITE_TO_MOVE_BIT) ? WHITE : BLACK);
+      if(bitbaseFloor >= beta) return bitbaseFloor;
+    }
+    if(result == BITBASE_LOSS){
+      bitbaseCeiling = -KNOWN_WIN + evaluate(board) - mopUp(board, (board.flags & WHITE_TO_MOVE_BIT) ? BLACK : WHITE);
+      if(bitbaseCeiling <= alpha && !checked) return bitbaseCeiling;//in check it could be mate, the search scores that
+    }
+  }
+  Move hashMove;
+  if(tt){
+    TranspositionTable::Entry entry;
+    if(tt->probe(board.hash(), entry, ply)){
+      hashMove = entry.move;
+      if(entry.depth >= depth){
+        if(entry.flag == TT_EXACT) return entry.score;
+        if(entry.flag == TT_LOWER && entry.score >= beta) return entry.score;
+        if(entry.flag == TT_UPPER && entry.score <= alpha) return entry.score;
+      }
+    }
+  }
+  //the on disk cache is only used for deeper nodes, it is slower than the table
+  bool cached = positionCache && depth >= POSITION_CACHE_MIN_DEPTH;
+  if(cached){
+    PositionCache::Result result;
+    if(positionCache->probe(board.hash(), result) && result.hasSearch){
+      if(hashMove.getMoveData() == 0) hashMove = result.move;
+      int score = scoreFromTT(result.score, ply);
+      if(result.depth >= depth){
+        if(result.flag == TT_EXACT) return score;
+        if(result.flag == TT_LOWER && score >= beta) return score;
+        if(result.flag == TT_UPPER && score <= alpha) return score;
+      }
+    }
+  }
+
+  //pruning is only done in zero window nodes, where the exact score is not needed
+  bool pvNode = beta - alpha > 1;
+  bool prunable = !pvNode && !checked && std::abs(beta) < MATE_SCORE - MAX_SEARCH_PLY;
+  int staticEval = prunable ? evaluate(board) : 0;
+  if(prunable && features.reverseFutility && depth <= RFP_MAX_DEPTH && staticEval - RFP_MARGIN*depth >= beta){
+    return staticEval;
+  }
+  if(prunable && features.razoring && depth <= RAZOR_MAX_DEPTH && staticEval + RAZOR_MARGIN*depth < alpha){
+    int score = quiescence(board, alpha, beta, ply);
+    if(score <= alpha) return score;
+  }
+  if(prunable && features.nullMove && allowNull && depth >= NULL_MOVE_MIN_DEPTH && staticEval >= beta){
+    int own = (board.flags & WHITE_TO_MOVE_BIT) ? WHITE : BLACK;
+    u64 pieces = board.bitboard(own+KNIGHT) | board.bitboard(own+BISHOP) | board.bitboard(own+ROOK) | board.bitboard(own+QUEEN);
+    if(pieces){//with only pawns, zugzwang is too likely
+      int r = 3 + depth/6;
+      board.makeNullMove();
+      int score = -alphaBeta(board, depth-1-r, -beta, -beta+1, ply+1, false);
+      board.unmakeNullMove();
+      if(stopped) return 0;
+      if(score >= beta){
+        if(score >= MATE_SCORE - MAX_SEARCH_PLY) score = beta;//a mate found after passing is not proven
+        if(depth < NULL_MOVE_VERIFY_DEPTH) return score;
+        //deep cutoffs are verified by a reduced search of this node without the null move
+        if(alphaBeta(board, depth-r, beta-1, beta, ply, false) >= beta) return score;
+        if(stopped) return 0;
+      }
+    }
+  }
+  bool futile = prunable && features.futility && depth <= FUTILITY_MAX_DEPTH && staticEval + FUTILITY_MARGIN*depth <= alpha;
+
+  int originalAlpha = alpha;
+  PlyMoves<ScoredMove> moves(scoredArena);
+  generateOrderedMoves(board, moves, hashMove);
+  if(moves.size() == 0) return checked ? -MATE_SCORE + ply : 0;
+  int best = -INFINITE_SCORE;
+  Move bestMove;
+  int searched = 0;
+  for(ScoredMove *m = moves.begin; m != moves.end; m++){
+    bool quiet = !isCapture(board, m->move);
+    bool reducible = features.lateMoveReductions && depth >= LMR_MIN_DEPTH && searched >= LMR_MIN_MOVES && !checked;
+    board.makeMove(m->move);
+    bool givesCheck = quiet && searched > 0 && (futile || reducible) && inCheck(board);
+    if(futile && quiet && searched > 0 && !givesCheck){
+      board.unmakeMove(m->move);
+      continue;
+    }
+    int reduction = reducible && quiet && !givesCheck ? std::min(lateMoveReduction(depth, searched), depth-2) : 0;
+    int score;
+    if(searched == 0 || (!features.principalVariation && reduction == 0)){
+      score = -alphaBeta(board, depth-1, -beta, -alpha, ply+1);
+    }else{
+      score = -alphaBeta(board, depth-1-reduction, -alpha-1, -alpha, ply+1);
+      if(score > alpha && reduction) score = -alphaBeta(board, depth-1, -alpha-1, -alpha, ply+1);
+      if(score > alpha && score < beta) score = -alphaBeta(board, depth-1, -beta, -alpha, ply+1);
+    }
+    board.unmakeMove(m->move);
+    searched++;
+    if(stopped) return 0;
+    if(score > best){
+      best = score;
+      bestMove = m->move;
+    }
+    if(score > alpha){
+      alpha = score;
+      updatePV(ply, m->move);
+    }
+    if(alpha >= beta) break;
+  }
+  //the flag is for what the search proved, a score moved by the bitbase bound is only that bound
+  int flag = best >= beta ? TT_LOWER : best > originalAlpha ? TT_EXACT : TT_UPPER;
+  if(best < bitbaseFloor){
+    best = bitbaseFloor;
+    flag = TT_LOWER;
+  }else if(best > bitbaseCeiling){
+    best = bitbaseCeiling;
+    flag = TT_UPPER;
+  }
+  if(tt) tt->store(board.hash(), depth, best, flag, bestMove, ply);
+  if(cached) positionCache->storeSearch(board.hash(), depth, scoreToTT(best, ply), flag, bestMove);
+  return best;
+}
+
+//searches every root move that is not excluded, previous is tried first if it is legal
+//returns a move with no data set if there are no legal moves left, the line is in pvTable[0]
+Move Search::rootSearch(Board &board, int depth, int &score, Move previous, std::vector<Move> const &excluded){
+  Move bestMove;
+  score = -INFINITE_SCORE;
+  pvLength[0] = 0;
+  PlyMoves<ScoredMove> moves(scoredArena);
+  generateOrderedMoves(board, moves);
+  if(moves.size() == 0){
+    score = inCheck(board) ? -MATE_SCORE : 0;
+    return bestMove;
+  }
+  if(!excluded.empty()){
+    ScoredMove *kept = moves.begin;
+    for(ScoredMove *m = moves.begin; m != moves.end; m++){
+      bool skip = false;
+      for(Move e : excluded) skip |= e.getMoveData() == m->move.getMoveData();
+      if(!skip) *kept++ = *m;
+    }
+    moves.end = kept;
+    if(moves.size() == 0) return bestMove;
+  }
+  for(ScoredMove *m = moves.begin; m != moves.end; m++){
+    if(m->move.getMoveData() == previous.getMoveData() && previous.getMoveData() != 0){
+      ScoredMove found = *m;
+      for(ScoredMove *j = m; j>moves.begin; j--) *j = *(j-1);
+      *moves.begin = found;
+      break;
+    }
+  }
+  if(board.ply >= MAX_GAME_PLY-1){//no move fits in the history, the callers stop games at MAX_ROOT_PLY
+    score = evaluate(board);
+    return bestMove;
+  }
+  int alpha = -INFINITE_SCORE;
+  for(ScoredMove *m = moves.begin; m != moves.end; m++){
+    board.makeMove(m->move);
+    int s = -alphaBeta(board, depth-1, -INFINITE_SCORE, -alpha, 1);
+    board.unmakeMove(m->move);
+    if(stopped) break;
+    if(s > score){
+      score = s;
+      bestMove = m->move;
+      updatePV(0, m->move);
+    }
+    if(s > alpha) alpha = s;
+  }
+  return bestMove;
+}
+
+//fixed depth search
+Move Search::findBestMove(Board &board, int depth, int &score){
+  nodes = 0;
+  if(tt) tt->newSearch();
+  nodeLimit = 0;
+  stopped = false;
+  return rootSearch(board, depth, score, Move());
+}
+
+//iterative deepening up to maxDepth, stopped once maxNodes are visited (0 is no limit)
+//returns the move from the last finished depth, depth 1 always finishes
+//book moves are returned without searching, with a score of 0
+Move Search::searchBestMove(Board &board, int maxDepth, u64 maxNodes, int &score){
+  nodes = 0;
+  Move bookMove;
+  if(book && book->probe(board, *this, bookMove)){
+    score = 0;
+    return bookMove;
+  }
+  if(tt) tt->newSearch();
+  nodeLimit = 0;
+  stopped = false;
+  Move best = rootSearch(board, 1, score, Move());
+  nodeLimit = maxNodes;
+  for(int depth = 2; depth<=maxDepth && !stopped; depth++){
+    int s;
+    Move m = rootSearch(board, depth, s, best);
+    if(stopped) break;
+    best = m;
+    score = s;
+  }
+  nodeLimit = 0;
+  stopped = false;
+  return best;
+}
@@ -0,0 +1,91 @@
+#include "../search.h"
+#include <algorithm>
+
+//hash table and position cache cutoffs end the triangular line early, so it is continued with legal hash moves up to length
+void Search::extendPV(Board &board, std::vector<Move> &pv, int length){
+  if(!tt && !positionCache) return;
+  for(Move m : pv) board.makeMove(m);
+  int played = pv.size();
+  while((int)pv.size() < length && !board.isRepetition()){
+    TranspositionTable::Entry entry;
+    PositionCache::Result result;
+    Move next;
+    if(tt && tt->probe(board.hash(), entry, 0)) next = entry.move;
+    else if(positionCache && positionCache->probe(board.hash(), result) && result.hasSearch) next = result.move;
+    if(next.getMoveData() == 0) break;
+    MoveList moves;
+    generateMoves(board, moves);
+    bool legal = false;
+    for(int i = 0; i<moves.end; i++) legal |= moves.moves[i].getMoveData() == next.getMoveData();
+    if(!legal) break;
+    pv.push_back(next);
+    board.makeMove(next);
+    played++;
+  }
+  while(played--) board.unmakeMove(pv[played]);
+}
+
+std::vector<AnalysisLine> Search::analyze(Board &board, int maxDepth, int lineCount, u64 maxNodes,
+                                          std::function<void(int depth, std::vector<AnalysisLine> const &lines)> const &report){
+  nodes = 0;
+  if(tt) tt->newSearch();
+  stopped = false;
+  std::vector<AnalysisLine> result;
+  for(int depth = 1; depth<=maxDepth; depth++){
+    nodeLimit = depth == 1 ? 0 : maxNodes;//depth 1 always finishes
+    std::vector<AnalysisLine> lines;
+    std::vector<Move> excluded;
+    for(int k = 0; k<lineCount; k++){
+      //the move that was kth last depth is tried first
+      Move previous = k < (int)result.size() ? result[k].pv[0] : Move();
+      int score;
+      Move m = rootSearch(board, depth, score, previous, excluded);
+      if(stopped || m.getMoveData() == 0) break;
+      lines.push_back({score, principalVariation()});
+      extendPV(board, lines.back().pv, depth);
+      excluded.push_back(m);
+    }
+    if(stopped) break;
+    std::stable_sort(lines.begin(), lines.end(), [](AnalysisLine const &a, AnalysisLine const &b){return a.score > b.score;});
+    result = lines;
+    if(report) report(depth, result);
+  }
+  nodeLimit = 0;
+  stopped = false;
+  return result;
+}
+
+//every line count searches the same positions to the same depth with a cleared hash table
+//the book and the position cache are detached, their hits would hide the cost of the extra lines
+void Search::runMultiPVBench(int depth){
+  if(depth <= 0) depth = 5;
+  if(!tt) tt = std::make_shared<TranspositionTable>();
+  std::shared_ptr<const OpeningBook> savedBook = book;
+  std::shared_ptr<PositionCache> savedCache = positionCache;
+  book = nullptr;
+  positionCache = nullptr;
+  Board board;
+  u64 baseNodes = 0, baseNs = 0;
+  for(int lines : {1, 2, 4, 8}){
+    u64 totalNodes = 0;
+    u64 ns = 0;
+    for(BenchPosition const &position : benchPositions){
+      board.loadFromFEN(position.fen);
+      tt->clear();
+      auto start = std::chrono::high_resolution_clock::now();
+      analyze(board, depth, lines, 0, nullptr);
+      auto end = std::chrono::high_resolution_clock::now();
+      totalNodes += nodes;
+      ns += std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+    }
+    if(lines == 1){
+      baseNodes = totalNodes;
+      baseNs = ns;
+    }
+    std::cout<<"Lines "<<lines<<" : "<<totalNodes<<" nodes, "<<(float)ns/1e9f<<"s, ";
+    std::cout<<(float)totalNodes/(baseNodes ? baseNodes : 1)<<"x nodes, "<<(float)ns/(baseNs ? baseNs : 1)<<"x time\n";
+  }
+  book = savedBook;
+  positionCache = savedCache;
+  std::cout<<std::flush;
+}
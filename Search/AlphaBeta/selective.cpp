@@ -0,0 +1,66 @@
+#include "../search.h"
+
+bool SearchFeatures::set(std::string const &name, bool on){
+  if(name == "pvs") principalVariation = on;
+  else if(name == "nmp") nullMove = on;
+  else if(name == "lmr") lateMoveReductions = on;
+  else if(name == "rfp") reverseFutility = on;
+  else if(name == "futility") futility = on;
+  else if(name == "razoring") razoring = on;
+  else if(name == "checkext") checkExtensions = on;
+  else return false;
+  return true;
+}
+
+//iterative deepening to the same depth on every position with a cleared hash table, first with everything off,
+//then pvs alone (the pruning only happens in its zero window nodes), then pvs with each technique, then everything
+//agree is how many positions get the same best move as the plain search
+void Search::runSelectiveBench(int depth){
+  if(depth <= 0) depth = 6;
+  if(!tt) tt = std::make_shared<TranspositionTable>();
+  std::string names[7] = {"pvs", "nmp", "lmr", "rfp", "futility", "razoring", "checkext"};
+  std::vector<std::vector<std::string>> configs = {{}, {"pvs"}};
+  for(int i = 1; i<7; i++) configs.push_back({"pvs", names[i]});
+  configs.push_back(std::vector<std::string>(names, names+7));
+  SearchFeatures saved = features;
+  std::shared_ptr<const OpeningBook> savedBook = book;
+  std::shared_ptr<PositionCache> savedCache = positionCache;//its scores are for the features it was opened with
+  book = nullptr;
+  positionCache = nullptr;
+  Board board;
+  u64 baseNodes = 0, baseNs = 0;
+  Move baseMoves[BENCH_POSITIONS];
+  std::cout<<"Depth "<<depth<<"\n";
+  for(std::vector<std::string> const &config : configs){
+    for(std::string const &name : names) features.set(name, false);
+    std::string label = config.empty() ? "plain" : config.size() == 7 ? "all" : "";
+    for(std::string const &name : config){
+      features.set(name, true);
+      if(config.size() < 7) label += (label.empty() ? "" : "+") + name;
+    }
+    u64 totalNodes = 0, ns = 0;
+    int agree = 0;
+    for(int i = 0; i<BENCH_POSITIONS; i++){
+      board.loadFromFEN(benchPositions[i].fen);
+      tt->clear();
+      int score;
+      auto start = std::chrono::high_resolution_clock::now();
+      Move best = searchBestMove(board, depth, 0, score);
+      auto end = std::chrono::high_resolution_clock::now();
+      totalNodes += nodes;
+      ns += std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+      if(config.empty()) baseMoves[i] = best;
+      agree += best.getMoveData() == baseMoves[i].getMoveData();
+    }
+    if(config.empty()){
+      baseNodes = totalNodes;
+      baseNs = ns;
+    }
+    std::cout<<label<<std::string(label.size() < 18 ? 18-label.size() : 1, ' ')<<": "<<totalNodes<<" nodes, "<<(float)ns/1e9f<<"s, ";
+    std::cout<<(float)totalNodes/(baseNodes ? baseNodes : 1)<<"x nodes, "<<(float)ns/(baseNs ? baseNs : 1)<<"x time, ";
+    std::cout<<agree<<"/"<<BENCH_POSITIONS<<" agree"<<std::endl;
+  }
+  features = saved;
+  book = savedBook;
+  positionCache = savedCache;
+}
@@ -0,0 +1,186 @@
+#include "../search.h"
+#include "fill.h"
+#include "positionbatch.h"
+
+//pawnCaptures[side][square], side 0 is white
+void Search::generatePawnCaptures(){
+  for(int square = 0; square<64; square++){
+    u64 white = 0;
+    u64 black = 0;
+    if(square < 56 && square%8 != 0) setBit(white, square+7);
+    if(square < 56 && square%8 != 7) setBit(white, square+9);
+    if(square > 7 && square%8 != 7) setBit(black, square-7);
+    if(square > 7 && square%8 != 0) setBit(black, square-9);
+    pawnCaptures[0][square] = white;
+    pawnCaptures[1][square] = black;
+  }
+}
+
+//pieces of both colors that attack square, sliders see through anything not in occupancy
+u64 Search::attackersTo(Position const &board, int square, u64 occupancy) const{
+  u64 queens = board.pieceBitboards[QUEEN];
+  return (pawnCaptures[1][square] & board.bitboard(WHITE+PAWN))
+       | (pawnCaptures[0][square] & board.bitboard(BLACK+PAWN))
+       | (knightMoves[square] & board.pieceBitboards[KNIGHT])
+       | (kingMoves[square] & board.pieceBitboards[KING])
+       | (rookAttacks(square, occupancy) & (board.pieceBitboards[ROOK] | queens))
+       | (bishopAttacks(square, occupancy) & (board.pieceBitboards[BISHOP] | queens));
+}
+
+//every square attacked by color (WHITE or BLACK)
+u64 Search::attacks(Position const &board, int color, u64 occupancy) const{
+  u64 pawns = board.bitboard(color+PAWN);
+  u64 attacked = (color == WHITE)
+    ? ((pawns<<7) & ~fileMasks[7]) | ((pawns<<9) & ~fileMasks[0])
+    : ((pawns>>7) & ~fileMasks[0]) | ((pawns>>9) & ~fileMasks[7]);
+  u64 knights = board.bitboard(color+KNIGHT);
+  while(knights) attacked |= knightMoves[popLsb(knights)];
+  attacked |= kingMoves[lsb(board.bitboard(color+KING))];
+  u64 queens = board.bitboard(color+QUEEN);
+  return attacked | slidingAttacks(board.bitboard(color+ROOK) | queens, board.bitboard(color+BISHOP) | queens, occupancy);
+}
+
+//for the side to move
+AttackInfo Search::computeAttackInfo(Position const &board) const{
+  AttackInfo info;
+  int own = (board.flags & WHITE_TO_MOVE_BIT) ? WHITE : BLACK;
+  int enemy = (own == WHITE) ? BLACK : WHITE;
+  u64 ownPieces = board.colorBitboards[own/6];
+  u64 enemyPieces = board.colorBitboards[enemy/6];
+  u64 occupancy = ownPieces | enemyPieces;
+  int king = lsb(board.bitboard(own+KING));
+  //the king is left out so squares behind it along a checking line count as attacked
+  info.attacked = attacks(board, enemy, occupancy & ~((u64)1<<king));
+  info.checkers = attackersTo(board, king, occupancy) & enemyPieces;
+
+  //enemy sliders that would hit the king if only own pieces were removed
+  u64 queens = board.bitboard(enemy+QUEEN);
+  u64 rookSnipers = rookAttacks(king, enemyPieces) & (board.bitboard(enemy+ROOK) | queens);
+  u64 bishopSnipers = bishopAttacks(king, enemyPieces) & (board.bitboard(enemy+BISHOP) | queens);
+  //the rays of the king and sniper only overlap between them, a single own piece there is pinned
+  info.pinned = 0;
+  u64 kingRook = rookAttacks(king, occupancy);
+  while(rookSnipers){
+    u64 between = kingRook & rookAttacks(popLsb(rookSnipers), occupancy) & ownPieces;
+    info.pinned |= between;
+  }
+  u64 kingBishop = bishopAttacks(king, occupancy);
+  while(bishopSnipers){
+    u64 between = kingBishop & bishopAttacks(popLsb(bishopSnipers), occupancy) & ownPieces;
+    info.pinned |= between;
+  }
+  return info;
+}
+
+//computed once per ply, makeMove starts each new ply with an invalid entry and unmakeMove returns to a valid one
+AttackInfo const &Search::attackInfo(Board &board) const{
+  BoardState &state = board.history[board.ply];
+  if(!state.attacksValid){
+    state.attacks = computeAttackInfo(board);
+    state.attacksValid = true;
+  }
+  return state.attacks;
+}
+
+bool Search::isAttacked(Position const &board, byte square, byte opponentColor){
+  return attackersTo(board, square, board.occupancy()) & board.colorBitboards[opponentColor/6];
+}
+
+bool Search::inCheck(Position const &board){
+  int own = (board.flags & WHITE_TO_MOVE_BIT) ? WHITE : BLACK;
+  return isAttacked(board, lsb(board.bitboard(own+KING)), own == WHITE ? BLACK : WHITE);
+}
+
+bool Search::inCheck(Board &board){
+  return attackInfo(board).checkers != 0;
+}
+
+//whole-side slider attacks with one magic lookup per piece against the fill kernels, on positions from random games
+void Search::runAttackBench(){
+  const int count = 100000;
+  std::vector<Position> positions = randomGamePositions(count);
+  auto magicAttacks = [this](u64 rooks, u64 bishops, u64 occupancy){
+    u64 attacked = 0;
+    while(rooks) attacked |= rookAttacks(popLsb(rooks), occupancy);
+    while(bishops) attacked |= bishopAttacks(popLsb(bishops), occupancy);
+    return attacked;
+  };
+  const char *names[3] = {"magic ", "scalar", "avx2  "};
+  u64 checksums[3] = {};
+  u64 ns[3] = {};
+  int mismatches = 0;
+  const int rounds = 20;
+  for(int kernel = 0; kernel<3; kernel++){
+    if(kernel == 2 && !hasAVX2()) break;
+    auto start = std::chrono::high_resolution_clock::now();
+    for(int r = 0; r<rounds; r++){
+      for(Position const &p : positions){
+        u64 occupancy = p.occupancy();
+        for(int color = WHITE; color<=BLACK; color += BLACK){
+          u64 queens = p.bitboard(color+QUEEN);
+          u64 rooks = p.bitboard(color+ROOK) | queens;
+          u64 bishops = p.bitboard(color+BISHOP) | queens;
+          u64 attacked = kernel == 0 ? magicAttacks(rooks, bishops, occupancy)
+                       : kernel == 1 ? slidingAttacksScalar(rooks, bishops, occupancy)
+                       : slidingAttacksAVX2(rooks, bishops, occupancy);
+          checksums[kernel] = checksums[kernel]*31 + attacked;
+        }
+      }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    ns[kernel] = std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+    if(checksums[kernel] != checksums[0]) mismatches++;
+    std::cout<<names[kernel]<<" : "<<(u64)count*rounds*2*1000000000/(ns[kernel] ? ns[kernel] : 1)<<" sides/s\n";
+  }
+  std::cout<<"Selected kernel : "<<slidingAttacksKernel()<<"\n";
+  if(mismatches) std::cout<<"\x1b[31m[error] fill attacks differ from magic attacks\x1b[0m\n";
+  std::cout<<std::flush;
+}
+
+//legal move counts, attack maps and check flags, one position at a time against the batch kernels
+void Search::runBatchBench(){
+  const int count = 100000;
+  std::vector<Position> positions = randomGamePositions(count);
+  PositionBatch batch;
+  batch.reserve(count);
+  for(Position const &p : positions) batch.add(p);
+  const int rounds = 10;
+
+  BatchResults expected;
+  expected.moveCounts.resize(count);
+  expected.attacked.resize(count);
+  expected.inCheck.resize(count);
+  Move moves[256];
+  auto start = std::chrono::high_resolution_clock::now();
+  for(int r = 0; r<rounds; r++){
+    for(int i = 0; i<count; i++){
+      AttackInfo info = computeAttackInfo(positions[i]);
+      expected.moveCounts[i] = generateMoves(positions[i], info, moves) - moves;
+      expected.attacked[i] = info.attacked;
+      expected.inCheck[i] = info.checkers != 0;
+    }
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+  u64 ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+  std::cout<<"single : "<<(u64)count*rounds*1000000000/(ns ? ns : 1)<<" positions/s\n";
+
+  const char *names[2] = {"scalar", "avx2  "};
+  for(int kernel = 0; kernel<2; kernel++){
+    if(kernel == 1 && !hasAVX2()) break;
+    BatchResults results;
+    start = std::chrono::high_resolution_clock::now();
+    for(int r = 0; r<rounds; r++){
+      if(kernel == 0) countMovesBatchScalar(batch, results);
+      else countMovesBatchAVX2(batch, results);
+    }
+    end = std::chrono::high_resolution_clock::now();
+    ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+    int mismatches = 0;
+    for(int i = 0; i<count; i++){
+      if(results.moveCounts[i] != expected.moveCounts[i] || results.attacked[i] != expected.attacked[i] || results.inCheck[i] != expected.inCheck[i]) mismatches++;
+    }
+    std::cout<<names[kernel]<<" : "<<(u64)count*rounds*1000000000/(ns ? ns : 1)<<" positions/s\n";
+    if(mismatches) std::cout<<"\x1b[31m[error] "<<mismatches<<" positions differ from the single position path\x1b[0m\n";
+  }
+  std::cout<<std::flush;
+}
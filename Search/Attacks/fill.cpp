@@ -0,0 +1,96 @@
+#include "fill.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FILL_X86
+#endif
+
+//square index is rank*8 + (7-file), so index%8 == 0 is the h file and index%8 == 7 is the a file
+//a shift by one of these can wrap around the board edge, the mask removes squares it would land on
+static const u64 NOT_H_FILE = 0xFEFEFEFEFEFEFEFEull;
+static const u64 NOT_A_FILE = 0x7F7F7F7F7F7F7F7Full;
+static const u64 ALL_SQUARES = 0xFFFFFFFFFFFFFFFFull;
+
+//generators are flooded through empty squares, one more step adds the blocker
+static inline u64 fillLeft(u64 gen, u64 empty, int s, u64 mask){
+  u64 pro = empty & mask;
+  gen |= pro & (gen << s);
+  pro &= pro << s;
+  gen |= pro & (gen << 2*s);
+  pro &= pro << 2*s;
+  gen |= pro & (gen << 4*s);
+  return (gen << s) & mask;
+}
+
+static inline u64 fillRight(u64 gen, u64 empty, int s, u64 mask){
+  u64 pro = empty & mask;
+  gen |= pro & (gen >> s);
+  pro &= pro >> s;
+  gen |= pro & (gen >> 2*s);
+  pro &= pro >> 2*s;
+  gen |= pro & (gen >> 4*s);
+  return (gen >> s) & mask;
+}
+
+u64 slidingAttacksScalar(u64 rooks, u64 bishops, u64 occupancy){
+  u64 empty = ~occupancy;
+  return fillLeft(rooks, empty, 8, ALL_SQUARES)    | fillRight(rooks, empty, 8, ALL_SQUARES)
+       | fillLeft(rooks, empty, 1, NOT_H_FILE)     | fillRight(rooks, empty, 1, NOT_A_FILE)
+       | fillLeft(bishops, empty, 9, NOT_H_FILE)   | fillRight(bishops, empty, 9, NOT_A_FILE)
+       | fillLeft(bishops, empty, 7, NOT_A_FILE)   | fillRight(bishops, empty, 7, NOT_H_FILE);
+}
+
+#ifdef FILL_X86
+//one register per shift direction, each lane is one ray direction: {1, 7, 8, 9}
+__attribute__((target("avx2")))
+u64 slidingAttacksAVX2(u64 rooks, u64 bishops, u64 occupancy){
+  const __m256i shift1 = _mm256_setr_epi64x(1, 7, 8, 9);
+  const __m256i shift2 = _mm256_setr_epi64x(2, 14, 16, 18);
+  const __m256i shift4 = _mm256_setr_epi64x(4, 28, 32, 36);
+  const __m256i leftMask = _mm256_setr_epi64x(NOT_H_FILE, NOT_A_FILE, ALL_SQUARES, NOT_H_FILE);
+  const __m256i rightMask = _mm256_setr_epi64x(NOT_A_FILE, NOT_H_FILE, ALL_SQUARES, NOT_A_FILE);
+  __m256i gen = _mm256_setr_epi64x(rooks, bishops, rooks, bishops);
+  __m256i empty = _mm256_set1_epi64x(~occupancy);
+
+  __m256i genL = gen;
+  __m256i proL = _mm256_and_si256(empty, leftMask);
+  genL = _mm256_or_si256(genL, _mm256_and_si256(proL, _mm256_sllv_epi64(genL, shift1)));
+  proL = _mm256_and_si256(proL, _mm256_sllv_epi64(proL, shift1));
+  genL = _mm256_or_si256(genL, _mm256_and_si256(proL, _mm256_sllv_epi64(genL, shift2)));
+  proL = _mm256_and_si256(proL, _mm256_sllv_epi64(proL, shift2));
+  genL = _mm256_or_si256(genL, _mm256_and_si256(proL, _mm256_sllv_epi64(genL, shift4)));
+  genL = _mm256_and_si256(_mm256_sllv_epi64(genL, shift1), leftMask);
+
+  __m256i genR = gen;
+  __m256i proR = _mm256_and_si256(empty, rightMask);
+  genR = _mm256_or_si256(genR, _mm256_and_si256(proR, _mm256_srlv_epi64(genR, shift1)));
+  proR = _mm256_and_si256(proR, _mm256_srlv_epi64(proR, shift1));
+  genR = _mm256_or_si256(genR, _mm256_and_si256(proR, _mm256_srlv_epi64(genR, shift2)));
+  proR = _mm256_and_si256(proR, _mm256_srlv_epi64(proR, shift2));
+  genR = _mm256_or_si256(genR, _mm256_and_si256(proR, _mm256_srlv_epi64(genR, shift4)));
+  genR = _mm256_and_si256(_mm256_srlv_epi64(genR, shift1), rightMask);
+
+  //fold the 4 lanes into one bitboard
+  __m256i all = _mm256_or_si256(genL, genR);
+  __m128i half = _mm_or_si128(_mm256_castsi256_si128(all), _mm256_extracti128_si256(all, 1));
+  return (u64)_mm_cvtsi128_si64(half) | (u64)_mm_extract_epi64(half, 1);
+}
+
+bool hasAVX2(){
+  __builtin_cpu_init();//this can run before the cpu model is set up by the static constructors
+  return __builtin_cpu_supports("avx2");
+}
+#else
+u64 slidingAttacksAVX2(u64 rooks, u64 bishops, u64 occupancy){
+  return slidingAttacksScalar(rooks, bishops, occupancy);
+}
+
+bool hasAVX2(){
+  return false;
+}
+#endif
+
+u64 (*slidingAttacks)(u64, u64, u64) = hasAVX2() ? slidingAttacksAVX2 : slidingAttacksScalar;
+
+const char *slidingAttacksKernel(){
+  return slidingAttacks == slidingAttacksAVX2 ? "avx2" : "scalar";
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include "../../Board/Bitboards/bitboard.h"
+
+//set-wise sliding attacks, every slider of a side at once with occluded Kogge-Stone fills
+//queens go in both rooks and bishops, the attacks include the blockers (own pieces too)
+u64 slidingAttacksScalar(u64 rooks, u64 bishops, u64 occupancy);
+u64 slidingAttacksAVX2(u64 rooks, u64 bishops, u64 occupancy);//only call when hasAVX2() is true
+
+bool hasAVX2();
+//picked once at startup, AVX2 when the cpu supports it
+extern u64 (*slidingAttacks)(u64 rooks, u64 bishops, u64 occupancy);
+const char *slidingAttacksKernel();
@@ -0,0 +1,253 @@
+#include "positionbatch.h"
+#include "fill.h"
+#include <cstring>
+//every function returning the 32 byte lanes below is always inlined, so the warning about returning them without AVX does not apply
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+void PositionBatch::clear(){
+  for(int i = 0; i<6; i++){
+    own[i].clear();
+    enemy[i].clear();
+  }
+  castling.clear();
+  enPassan.clear();
+  blackToMove.clear();
+}
+
+void PositionBatch::reserve(int count){
+  for(int i = 0; i<6; i++){
+    own[i].reserve(count);
+    enemy[i].reserve(count);
+  }
+  castling.reserve(count);
+  enPassan.reserve(count);
+  blackToMove.reserve(count);
+}
+
+void PositionBatch::add(Position const &position){
+  bool black = !(position.flags & WHITE_TO_MOVE_BIT);
+  int us = black ? BLACK : WHITE;
+  int them = black ? WHITE : BLACK;
+  //a vertical flip is a byte swap, square ^ 56
+  for(int i = 0; i<6; i++){
+    u64 a = position.bitboard(us+i);
+    u64 b = position.bitboard(them+i);
+    own[i].push_back(black ? __builtin_bswap64(a) : a);
+    enemy[i].push_back(black ? __builtin_bswap64(b) : b);
+  }
+  u64 rights = 0;
+  if(position.flags & (black ? BLACK_KINGSIDE_BIT : WHITE_KINGSIDE_BIT)) rights |= 1;
+  if(position.flags & (black ? BLACK_QUEENSIDE_BIT : WHITE_QUEENSIDE_BIT)) rights |= 2;
+  castling.push_back(rights);
+  u64 ep = 0;
+  if(position.enPassanTarget != EN_PASSAN_NULL) ep = (u64)1<<(black ? position.enPassanTarget^56 : position.enPassanTarget);
+  enPassan.push_back(ep);
+  blackToMove.push_back(black);
+}
+
+namespace{
+//same square numbering as fill.cpp, index%8 == 0 is the h file
+const u64 NOT_H_FILE = 0xFEFEFEFEFEFEFEFEull;
+const u64 NOT_A_FILE = 0x7F7F7F7F7F7F7F7Full;
+const u64 NOT_GH_FILE = 0xFCFCFCFCFCFCFCFCull;
+const u64 NOT_AB_FILE = 0x3F3F3F3F3F3F3F3Full;
+const u64 RANK_3 = 0x0000000000FF0000ull;
+const u64 RANK_8 = 0xFF00000000000000ull;
+
+//ray directions, 0-3 shift left by {1, 7, 8, 9}, 4-7 shift right by the same amounts
+//direction d and d^4 lie on the same line, rook lines are 0 and 2, bishop lines 1 and 3
+const int RAY_SHIFTS[4] = {1, 7, 8, 9};
+const u64 RAY_MASKS[8] = {NOT_H_FILE, NOT_A_FILE, ~0ull, NOT_H_FILE, NOT_A_FILE, NOT_H_FILE, ~0ull, NOT_A_FILE};
+const bool RAY_ROOK[4] = {true, false, true, false};
+
+//lanes of 4 positions with gcc vector extensions, inside the AVX2 function they become AVX2 instructions
+typedef u64 Lanes __attribute__((vector_size(32)));
+
+//all ones in lanes where x is not zero
+inline __attribute__((always_inline)) u64 nonZero(u64 x){return x ? ~0ull : 0;}
+inline __attribute__((always_inline)) Lanes nonZero(Lanes const &x){return (Lanes)(x != 0);}
+inline __attribute__((always_inline)) void addCount(u64 &count, u64 x){count += __builtin_popcountll(x);}
+inline __attribute__((always_inline)) void addCount(Lanes &count, Lanes const &x){
+  for(int i = 0; i<4; i++) count[i] += __builtin_popcountll(x[i]);
+}
+inline __attribute__((always_inline)) void load(u64 &lanes, u64 const *p){lanes = *p;}
+inline __attribute__((always_inline)) void load(Lanes &lanes, u64 const *p){memcpy(&lanes, p, sizeof(Lanes));}
+
+template<typename T>
+inline __attribute__((always_inline)) T shift(T const &x, int d){
+  return d < 4 ? (x << RAY_SHIFTS[d]) & RAY_MASKS[d] : (x >> RAY_SHIFTS[d-4]) & RAY_MASKS[d];
+}
+
+//occluded fill from gen in direction d, including the first blocker
+template<typename T>
+inline __attribute__((always_inline)) T ray(T const &from, T const &empty, int d){
+  int s = RAY_SHIFTS[d&3];
+  T gen = from;
+  T pro = empty & RAY_MASKS[d];
+  if(d < 4){
+    gen |= pro & (gen << s);
+    pro &= pro << s;
+    gen |= pro & (gen << 2*s);
+    pro &= pro << 2*s;
+    gen |= pro & (gen << 4*s);
+  }else{
+    gen |= pro & (gen >> s);
+    pro &= pro >> s;
+    gen |= pro & (gen >> 2*s);
+    pro &= pro >> 2*s;
+    gen |= pro & (gen >> 4*s);
+  }
+  return shift(gen, d);
+}
+
+template<typename T>
+inline __attribute__((always_inline)) T knightFill(T const &x){
+  return ((x << 17) & NOT_H_FILE) | ((x << 15) & NOT_A_FILE) | ((x << 10) & NOT_GH_FILE) | ((x << 6) & NOT_AB_FILE)
+       | ((x >> 17) & NOT_A_FILE) | ((x >> 15) & NOT_H_FILE) | ((x >> 10) & NOT_AB_FILE) | ((x >> 6) & NOT_GH_FILE);
+}
+
+template<typename T>
+inline __attribute__((always_inline)) T kingFill(T const &x){
+  T fill = x;
+  for(int d = 0; d<8; d++) fill |= shift(x, d);
+  return fill & ~x;
+}
+
+//the side to move always moves up the board
+template<typename T>
+inline __attribute__((always_inline)) T ownPawnAttacks(T const &pawns){return shift(pawns, 1) | shift(pawns, 3);}
+template<typename T>
+inline __attribute__((always_inline)) T enemyPawnAttacks(T const &pawns){return shift(pawns, 5) | shift(pawns, 7);}
+
+//one lane group starting at index i
+template<typename T>
+inline __attribute__((always_inline)) void countLanes(PositionBatch const &batch, BatchResults &results, int i){
+  T own[6], enemy[6], castling, ep;
+  for(int p = 0; p<6; p++){
+    load(own[p], &batch.own[p][i]);
+    load(enemy[p], &batch.enemy[p][i]);
+  }
+  load(castling, &batch.castling[i]);
+  load(ep, &batch.enPassan[i]);
+  T ownPieces = own[PAWN] | own[BISHOP] | own[KNIGHT] | own[ROOK] | own[QUEEN] | own[KING];
+  T enemyPieces = enemy[PAWN] | enemy[BISHOP] | enemy[KNIGHT] | enemy[ROOK] | enemy[QUEEN] | enemy[KING];
+  T empty = ~(ownPieces | enemyPieces);
+  T king = own[KING];
+  T ownSliders[2] = {own[BISHOP] | own[QUEEN], own[ROOK] | own[QUEEN]};
+  T enemySliders[2] = {enemy[BISHOP] | enemy[QUEEN], enemy[ROOK] | enemy[QUEEN]};
+
+  //enemy attacks with the king removed, so it can not step back along a checking line
+  T attacked = enemyPawnAttacks(enemy[PAWN]) | knightFill(enemy[KNIGHT]) | kingFill(enemy[KING]);
+  for(int d = 0; d<8; d++) attacked |= ray(enemySliders[RAY_ROOK[d&3]], empty | king, d);
+
+  //checkers, the squares that block or capture a single check, and pins per line
+  T checkers = (ownPawnAttacks(king) & enemy[PAWN]) | (knightFill(king) & enemy[KNIGHT]);
+  T checkMask = checkers;
+  T pinnedLine[4];
+  T pinned = checkers & 0;
+  for(int d = 0; d<8; d++){
+    T sliders = enemySliders[RAY_ROOK[d&3]];
+    T kingRay = ray(king, empty, d);
+    T checker = kingRay & sliders;
+    checkers |= checker;
+    checkMask |= kingRay & nonZero(checker);
+    T blocker = kingRay & ownPieces;
+    T pin = blocker & nonZero(ray(blocker, empty, d) & sliders);
+    if(d < 4) pinnedLine[d] = pin;
+    else pinnedLine[d-4] |= pin;
+    pinned |= pin;
+  }
+  T single = nonZero(checkers) & ~nonZero(checkers & (checkers - 1));
+  //no check: anywhere, one check: block or capture, two checks: king moves only
+  T targets = ~ownPieces & (~nonZero(checkers) | (single & checkMask));
+
+  T count = checkers & 0;
+  addCount(count, kingFill(king) & ~ownPieces & ~attacked);
+  //sliders, every target in one direction is reached by exactly one slider, so counts can be summed per direction
+  for(int d = 0; d<8; d++){
+    T free = ~(pinned & ~pinnedLine[d&3]);
+    addCount(count, ray(ownSliders[RAY_ROOK[d&3]] & free, empty, d) & targets);
+  }
+  T knights = own[KNIGHT] & ~pinned;
+  T knightShifts[8] = {(knights << 17) & NOT_H_FILE, (knights << 15) & NOT_A_FILE, (knights << 10) & NOT_GH_FILE, (knights << 6) & NOT_AB_FILE,
+                       (knights >> 17) & NOT_A_FILE, (knights >> 15) & NOT_H_FILE, (knights >> 10) & NOT_AB_FILE, (knights >> 6) & NOT_GH_FILE};
+  for(int k = 0; k<8; k++) addCount(count, knightShifts[k] & targets);
+
+  //pawns, a promotion is 4 moves
+  T pushers = own[PAWN] & ~(pinned & ~pinnedLine[2]);
+  T push = shift(pushers, 2) & empty;
+  T doublePush = shift(push & RANK_3, 2) & empty & targets;
+  push &= targets;
+  T captureLeft = shift(own[PAWN] & ~(pinned & ~pinnedLine[1]), 1) & enemyPieces & targets;
+  T captureRight = shift(own[PAWN] & ~(pinned & ~pinnedLine[3]), 3) & enemyPieces & targets;
+  addCount(count, push);
+  addCount(count, doublePush);
+  addCount(count, captureLeft);
+  addCount(count, captureRight);
+  //two pawns can capture onto the same square, so each set is counted on its own
+  for(int k = 0; k<3; k++){
+    addCount(count, push & RANK_8);
+    addCount(count, captureLeft & RANK_8);
+    addCount(count, captureRight & RANK_8);
+  }
+
+  //en passant, checked by removing both pawns and looking for a slider on the king
+  T captured = shift(ep, 6);
+  T nonSliderCheck = checkers & (enemy[PAWN] | enemy[KNIGHT]) & ~captured;
+  for(int side = 5; side<=7; side += 2){
+    T from = shift(ep, side) & own[PAWN];//the pawn that captures along direction side^4
+    T occupied = ~empty ^ from ^ ep ^ captured;
+    T exposed = nonSliderCheck;
+    for(int d = 0; d<8; d++) exposed |= ray(king, ~occupied, d) & enemySliders[RAY_ROOK[d&3]] & ~captured;
+    addCount(count, ep & nonZero(from) & ~nonZero(exposed));
+  }
+
+  //castling, the king can not be in check or pass through an attacked square
+  T kingside = nonZero(castling & 1) & ~nonZero(~empty & 0x6) & ~nonZero(attacked & 0xE);
+  T queenside = nonZero(castling & 2) & ~nonZero(~empty & 0x70) & ~nonZero(attacked & 0x38);
+  count += (kingside & 1) + (queenside & 1);
+
+  T check = nonZero(checkers);
+  for(int l = 0; l<(int)(sizeof(T)/sizeof(u64)); l++){
+    u64 map;
+    u64 c;
+    u64 n;
+    memcpy(&map, (u64*)&attacked + l, sizeof(u64));
+    memcpy(&c, (u64*)&check + l, sizeof(u64));
+    memcpy(&n, (u64*)&count + l, sizeof(u64));
+    results.moveCounts[i+l] = n;
+    results.attacked[i+l] = batch.blackToMove[i+l] ? __builtin_bswap64(map) : map;
+    results.inCheck[i+l] = c != 0;
+  }
+}
+
+void resize(PositionBatch const &batch, BatchResults &results){
+  results.moveCounts.resize(batch.size());
+  results.attacked.resize(batch.size());
+  results.inCheck.resize(batch.size());
+}
+}
+
+void countMovesBatchScalar(PositionBatch const &batch, BatchResults &results){
+  resize(batch, results);
+  for(int i = 0; i<batch.size(); i++) countLanes<u64>(batch, results, i);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2,popcnt")))
+void countMovesBatchAVX2(PositionBatch const &batch, BatchResults &results){
+  resize(batch, results);
+  int i = 0;
+  for(; i+4<=batch.size(); i += 4) countLanes<Lanes>(batch, results, i);
+  for(; i<batch.size(); i++) countLanes<u64>(batch, results, i);
+}
+#else
+void countMovesBatchAVX2(PositionBatch const &batch, BatchResults &results){
+  countMovesBatchScalar(batch, results);
+}
+#endif
+
+void countMovesBatch(PositionBatch const &batch, BatchResults &results){
+  if(slidingAttacks == slidingAttacksAVX2) countMovesBatchAVX2(batch, results);
+  else countMovesBatchScalar(batch, results);
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <vector>
+#include "../../Board/board.h"
+
+//many positions in structure of arrays layout, every position is stored from the side to move's point of view
+//(flipped vertically when black is to move) so each lane runs the same code with no color branches
+struct PositionBatch{
+  std::vector<u64> own[6];//PAWN..KING of the side to move
+  std::vector<u64> enemy[6];
+  std::vector<u64> castling;//bit 0 kingside, bit 1 queenside, of the side to move
+  std::vector<u64> enPassan;//target square as a bitboard, 0 for none
+  std::vector<byte> blackToMove;
+
+  void clear();
+  void reserve(int count);
+  void add(Position const &position);
+  int size() const {return blackToMove.size();}
+};
+
+struct BatchResults{
+  std::vector<unsigned short> moveCounts;//legal moves
+  std::vector<u64> attacked;//squares the opponent attacks, the own king is left out of the occupancy (board orientation)
+  std::vector<byte> inCheck;
+};
+
+//set-wise over lanes of positions, the AVX2 kernel runs 4 positions per register
+void countMovesBatchScalar(PositionBatch const &batch, BatchResults &results);
+void countMovesBatchAVX2(PositionBatch const &batch, BatchResults &results);//only call when hasAVX2() is true
+void countMovesBatch(PositionBatch const &batch, BatchResults &results);//uses the kernel slidingAttacks uses
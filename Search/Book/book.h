@@ -0,0 +1,29 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../../Board/board.h"
+
+class Search;
+
+//Polyglot .bin opening book, mapped read only and probed with a binary search
+//keys use the Random64 table of the Polyglot book format, it is compiled in and checked against the start position key
+class OpeningBook{
+  struct Mapping;
+  std::shared_ptr<Mapping> mapping;
+  u64 entryCount = 0;
+
+  u64 entryKey(u64 index) const;
+public:
+  struct Entry{
+    Move move;
+    unsigned short weight;
+  };
+  bool open(std::string const &bookPath);
+  bool isOpen() const {return entryCount != 0;}
+  u64 polyglotKey(Board const &board) const;
+  //legal moves for this position, highest weight first
+  std::vector<Entry> probeAll(Board &board, Search &search) const;
+  bool probe(Board &board, Search &search, Move &move) const;//the highest weighted move
+};
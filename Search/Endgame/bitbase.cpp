@@ -0,0 +1,328 @@
+#include "bitbase.h"
+#include "../search.h"
+
+namespace {
+enum : byte {UNKNOWN = 0, INVALID, DRAW, WIN};
+
+const int pieceCounts[Bitbases::ENDING_COUNT] = {1, 1, 1, 2};
+const byte pieceTypes[Bitbases::ENDING_COUNT][2] = {{PAWN, PAWN}, {ROOK, ROOK}, {QUEEN, QUEEN}, {BISHOP, KNIGHT}};
+
+struct Placement{
+  int blackToMove;
+  int whiteKing;
+  int blackKing;
+  int pieces[2];
+};
+
+Placement decode(u64 index, int count){
+  Placement p;
+  p.blackToMove = index & 1;
+  p.whiteKing = (index>>1) & 63;
+  p.blackKing = (index>>7) & 63;
+  p.pieces[0] = (index>>13) & 63;
+  p.pieces[1] = count > 1 ? (index>>19) & 63 : 0;
+  return p;
+}
+
+u64 encode(Placement const &p, int count){
+  u64 index = p.blackToMove | p.whiteKing<<1 | p.blackKing<<7 | p.pieces[0]<<13;
+  if(count > 1) index |= (u64)p.pieces[1]<<19;
+  return index;
+}
+
+u64 bit(int square){ return (u64)1<<square; }
+
+u64 checksum(u64 const *data, u64 length){
+  u64 hash = 0xcbf29ce484222325ull;
+  for(u64 i = 0; i<length; i++){
+    hash ^= data[i];
+    hash *= 0x100000001b3ull;
+    hash ^= hash>>29;
+  }
+  return hash;
+}
+}
+
+struct Bitbases::Generator{
+  Search const &search;
+  Bitbases const &done;//finished tables, used for promotions
+  int count;
+  byte const *types;
+  u64 size;
+  std::vector<std::atomic<byte>> state;
+  std::vector<std::atomic<byte>> counter;//legal black moves that do not lose yet
+
+  Generator(Search const &search, Bitbases const &done, Ending ending)
+    : search(search), done(done), count(pieceCounts[ending]), types(pieceTypes[ending]),
+      size((u64)1<<(13 + 6*count)), state(size), counter(size) {}
+
+  u64 attacks(byte type, int square, u64 occupancy) const{
+    switch(type){
+      case PAWN:{
+        u64 a = 0;
+        if(square%8 != 0) a |= bit(square+7);
+        if(square%8 != 7) a |= bit(square+9);
+        return a;
+      }
+      case KNIGHT: return search.knightAttacks(square);
+      case BISHOP: return search.bishopAttacks(square, occupancy);
+      case ROOK: return search.rookAttacks(square, occupancy);
+      case QUEEN: return search.rookAttacks(square, occupancy) | search.bishopAttacks(square, occupancy);
+    }
+    return 0;
+  }
+
+  //squares attacked by white, the piece on skip (if any) is ignored
+  u64 whiteAttacks(Placement const &p, u64 occupancy, int skip = -1) const{
+    u64 a = search.kingAttacks(p.whiteKing);
+    for(int i = 0; i<count; i++){
+      if(p.pieces[i] != skip) a |= attacks(types[i], p.pieces[i], occupancy);
+    }
+    return a;
+  }
+
+  u64 occupancy(Placement const &p) const{
+    u64 occ = bit(p.whiteKing) | bit(p.blackKing);
+    for(int i = 0; i<count; i++) occ |= bit(p.pieces[i]);
+    return occ;
+  }
+
+  //sets invalid, mate and stalemate positions and counts black's legal moves
+  void classify(u64 index, std::vector<u64> &wins){
+    Placement p = decode(index, count);
+    u64 occ = occupancy(p);
+    if(popcount(occ) != count+2 || (search.kingAttacks(p.whiteKing) & bit(p.blackKing))){
+      state[index] = INVALID;
+      return;
+    }
+    for(int i = 0; i<count; i++){
+      if(types[i] == PAWN && (p.pieces[i] < 8 || p.pieces[i] > 55)){
+        state[index] = INVALID;
+        return;
+      }
+    }
+    bool check = whiteAttacks(p, occ) & bit(p.blackKing);
+    if(!p.blackToMove){
+      if(check){
+        state[index] = INVALID;
+        return;
+      }
+      //promotions are wins if the resulting KQK or KRK position is won
+      for(int i = 0; i<count; i++){
+        int to = p.pieces[i]+8;
+        if(types[i] != PAWN || p.pieces[i] < 48 || (occ & bit(to))) continue;
+        Placement promoted = p;
+        promoted.blackToMove = 1;
+        promoted.pieces[i] = to;
+        u64 promotedIndex = encode(promoted, 1);
+        if(getBit(done.tables[KQK][promotedIndex/64], promotedIndex%64) || getBit(done.tables[KRK][promotedIndex/64], promotedIndex%64)){
+          state[index] = WIN;
+          wins.push_back(index);
+          return;
+        }
+      }
+      return;
+    }
+    u64 targets = search.kingAttacks(p.blackKing) & ~search.kingAttacks(p.whiteKing);
+    u64 withoutKing = occ & ~bit(p.blackKing);
+    int moves = 0;
+    while(targets){
+      int to = popLsb(targets);
+      //a capture removes that piece from the attackers
+      if(!(whiteAttacks(p, withoutKing, to) & bit(to))) moves++;
+    }
+    if(moves == 0){
+      state[index] = check ? WIN : DRAW;
+      if(check) wins.push_back(index);
+      return;
+    }
+    counter[index] = moves;
+  }
+
+  //index is a win, mark or count down the positions that could have come before it
+  void retract(u64 index, std::vector<u64> &wins){
+    Placement p = decode(index, count);
+    u64 occ = occupancy(p);
+    if(p.blackToMove){
+      //white just moved, any white move into this position wins
+      Placement previous = p;
+      previous.blackToMove = 0;
+      u64 from = search.kingAttacks(p.whiteKing) & ~occ & ~search.kingAttacks(p.blackKing);
+      while(from){
+        previous.whiteKing = popLsb(from);
+        markWin(encode(previous, count), wins);
+      }
+      previous.whiteKing = p.whiteKing;
+      for(int i = 0; i<count; i++){
+        int square = p.pieces[i];
+        if(types[i] == PAWN){
+          from = 0;
+          if(square >= 16 && !(occ & bit(square-8))){
+            from |= bit(square-8);
+            if(square >= 24 && square < 32 && !(occ & bit(square-16))) from |= bit(square-16);
+          }
+        }else{
+          from = attacks(types[i], square, occ) & ~occ;
+        }
+        while(from){
+          previous.pieces[i] = popLsb(from);
+          markWin(encode(previous, count), wins);
+        }
+        previous.pieces[i] = square;
+      }
+      return;
+    }
+    //black just moved, the position before is lost once every black move is
+    Placement previous = p;
+    previous.blackToMove = 1;
+    u64 from = search.kingAttacks(p.blackKing) & ~occ & ~search.kingAttacks(p.whiteKing);
+    while(from){
+      previous.blackKing = popLsb(from);
+      u64 previousIndex = encode(previous, count);
+      if(state[previousIndex] != UNKNOWN) continue;
+      if(counter[previousIndex].fetch_sub(1) == 1){
+        state[previousIndex] = WIN;
+        wins.push_back(previousIndex);
+      }
+    }
+  }
+
+  void markWin(u64 index, std::vector<u64> &wins){
+    byte expected = UNKNOWN;
+    if(state[index].compare_exchange_strong(expected, WIN)) wins.push_back(index);
+  }
+};
+
+void Bitbases::generate(Search const &search, Ending ending, int threads){
+  Generator g(search, *this, ending);
+  std::vector<std::vector<u64>> found(threads);
+  std::vector<std::thread> pool;
+  for(int t = 0; t<threads; t++){
+    pool.emplace_back([&, t](){
+      for(u64 i = t; i<g.size; i += threads) g.classify(i, found[t]);
+    });
+  }
+  for(std::thread &t : pool) t.join();
+  std::vector<u64> frontier;
+  for(auto &f : found){
+    frontier.insert(frontier.end(), f.begin(), f.end());
+    f.clear();
+  }
+  //one level per ply, each thread retracts its share of the frontier
+  while(!frontier.empty()){
+    pool.clear();
+    for(int t = 0; t<threads; t++){
+      pool.emplace_back([&, t](){
+        for(u64 i = t; i<frontier.size(); i += threads) g.retract(frontier[i], found[t]);
+      });
+    }
+    for(std::thread &t : pool) t.join();
+    frontier.clear();
+    for(auto &f : found){
+      frontier.insert(frontier.end(), f.begin(), f.end());
+      f.clear();
+    }
+  }
+  tables[ending].assign(g.size/64, 0);
+  for(u64 i = 0; i<g.size; i++){
+    if(g.state[i] == WIN) setBit(tables[ending][i/64], i%64);
+  }
+}
+
+bool Bitbases::build(Search const &search, int threads){
+  if(threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+  std::string names[ENDING_COUNT] = {"KPK", "KRK", "KQK", "KBNK"};
+  //KQK and KRK first, KPK promotes into them
+  Ending order[ENDING_COUNT] = {KQK, KRK, KPK, KBNK};
+  for(Ending ending : order){
+    auto start = std::chrono::steady_clock::now();
+    generate(search, ending, threads);
+    u64 ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now()-start).count();
+    std::cout<<"[generated "<<names[ending]<<" in "<<ms<<"ms]"<<std::endl;
+  }
+  return true;
+}
+
+u64 Bitbases::size() const{
+  u64 total = 0;
+  for(auto const &t : tables) total += t.size()*8;
+  return total;
+}
+
+//file: "CHSBB", version, checksum of the tables, then the tables in order
+bool Bitbases::save(std::string const &path) const{
+  std::vector<u64> data;
+  for(auto const &t : tables) data.insert(data.end(), t.begin(), t.end());
+  u64 header[3] = {0x4242534843ull, 1, checksum(data.data(), data.size())};
+  std::string temp = path + ".tmp";
+  std::ofstream file(temp, std::ofstream::out | std::ofstream::trunc | std::ofstream::binary);
+  if(!file.is_open()){
+    std::cout<<"[error] Could not open "<<temp<<std::endl;
+    return false;
+  }
+  file.write((char const *)header, sizeof(header));
+  file.write((char const *)data.data(), data.size()*8);
+  file.close();
+  if(file.fail() || std::rename(temp.c_str(), path.c_str()) != 0){
+    std::cout<<"[error] Could not write "<<path<<std::endl;
+    std::remove(temp.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool Bitbases::load(std::string const &path){
+  std::ifstream file(path, std::ifstream::binary);
+  if(!file.is_open()) return false;
+  u64 header[3];
+  if(!file.read((char *)header, sizeof(header)) || header[0] != 0x4242534843ull || header[1] != 1) return false;
+  std::vector<u64> data;
+  for(int e = 0; e<ENDING_COUNT; e++){
+    u64 entries = ((u64)1<<(13 + 6*pieceCounts[e]))/64;
+    tables[e].resize(entries);
+    if(!file.read((char *)tables[e].data(), entries*8)) return false;
+    data.insert(data.end(), tables[e].begin(), tables[e].end());
+  }
+  if(checksum(data.data(), data.size()) != header[2]){
+    std::cout<<"[warning] "<<path<<" failed its checksum"<<std::endl;
+    for(auto &t : tables) t.clear();
+    return false;
+  }
+  return true;
+}
+
+int Bitbases::probe(Position const &board) const{
+  u64 white = board.bitboard(WHITE_PIECES) & ~board.bitboard(WHITE+KING);
+  u64 black = board.bitboard(BLACK_PIECES) & ~board.bitboard(BLACK+KING);
+  if(white && black) return BITBASE_UNKNOWN;
+  //the stronger side becomes white, flipping the board for black
+  int strong = white ? WHITE : BLACK;
+  int weak = white ? BLACK : WHITE;
+  int flip = white ? 0 : 56;
+  u64 pieces = white | black;
+  Ending ending;
+  Placement p = {};
+  int count = popcount(pieces);
+  if(count == 1){
+    byte type = board.piece(lsb(pieces))%6;
+    if(type == PAWN) ending = KPK;
+    else if(type == ROOK) ending = KRK;
+    else if(type == QUEEN) ending = KQK;
+    else return BITBASE_UNKNOWN;
+    p.pieces[0] = lsb(pieces)^flip;
+  }else if(count == 2 && popcount(board.bitboard(strong+BISHOP)) == 1 && popcount(board.bitboard(strong+KNIGHT)) == 1){
+    ending = KBNK;
+    p.pieces[0] = lsb(board.bitboard(strong+BISHOP))^flip;
+    p.pieces[1] = lsb(board.bitboard(strong+KNIGHT))^flip;
+  }else{
+    return BITBASE_UNKNOWN;
+  }
+  if(tables[ending].empty()) return BITBASE_UNKNOWN;
+  bool strongToMove = (board.flags & WHITE_TO_MOVE_BIT) ? strong == WHITE : strong == BLACK;
+  p.blackToMove = !strongToMove;
+  p.whiteKing = lsb(board.bitboard(strong+KING))^flip;
+  p.blackKing = lsb(board.bitboard(weak+KING))^flip;
+  u64 index = encode(p, pieceCounts[ending]);
+  if(!getBit(tables[ending][index/64], index%64)) return BITBASE_DRAW;
+  return strongToMove ? BITBASE_WIN : BITBASE_LOSS;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "../../Board/board.h"
+
+class Search;
+
+#define BITBASE_LOSS   -1
+#define BITBASE_DRAW    0
+#define BITBASE_WIN     1
+#define BITBASE_UNKNOWN 2
+
+//Win/draw bitbases for KPK, KRK, KQK and KBNK, generated by retrograde analysis
+//Positions are stored with the stronger side as white, one bit per position: set if white wins
+//index = side to move | white king<<1 | black king<<7 | first piece<<13 | second piece<<19
+class Bitbases{
+public:
+  enum Ending{KPK = 0, KRK, KQK, KBNK, ENDING_COUNT};
+private:
+  std::vector<u64> tables[ENDING_COUNT];
+
+  struct Generator;
+  void generate(Search const &search, Ending ending, int threads);
+public:
+  bool build(Search const &search, int threads = 0);//threads = 0 uses every core
+  bool load(std::string const &path);
+  bool save(std::string const &path) const;
+  int probe(Position const &board) const;//from the side to move, BITBASE_UNKNOWN if the material is not covered
+  u64 size() const;//in bytes
+};
@@ -0,0 +1,401 @@
+#include "../search.h"
+
+//piece square tables from white's point of view, the first row is the first rank and index 0 is h1
+//they are symmetric between the kingside and queenside, so the mirrored file order does not matter
+namespace {
+const int pieceValues[6] = {100, 330, 320, 500, 900, 0};
+
+const int pawnTable[64] = {
+   0,  0,  0,  0,  0,  0,  0,  0,
+   5, 10, 10,-20,-20, 10, 10,  5,
+   5, -5,-10,  0,  0,-10, -5,  5,
+   0,  0,  0, 20, 20,  0,  0,  0,
+   5,  5, 10, 25, 25, 10,  5,  5,
+  10, 10, 20, 30, 30, 20, 10, 10,
+  50, 50, 50, 50, 50, 50, 50, 50,
+   0,  0,  0,  0,  0,  0,  0,  0
+};
+const int knightTable[64] = {
+ -50,-40,-30,-30,-30,-30,-40,-50,
+ -40,-20,  0,  5,  5,  0,-20,-40,
+ -30,  5, 10, 15, 15, 10,  5,-30,
+ -30,  0, 15, 20, 20, 15,  0,-30,
+ -30,  5, 15, 20, 20, 15,  5,-30,
+ -30,  0, 10, 15, 15, 10,  0,-30,
+ -40,-20,  0,  0,  0,  0,-20,-40,
+ -50,-40,-30,-30,-30,-30,-40,-50
+};
+const int bishopTable[64] = {
+ -20,-10,-10,-10,-10,-10,-10,-20,
+ -10,  5,  0,  0,  0,  0,  5,-10,
+ -10, 10, 10, 10, 10, 10, 10,-10,
+ -10,  0, 10, 10, 10, 10,  0,-10,
+ -10,  5,  5, 10, 10,  5,  5,-10,
+ -10,  0,  5, 10, 10,  5,  0,-10,
+ -10,  0,  0,  0,  0,  0,  0,-10,
+ -20,-10,-10,-10,-10,-10,-10,-20
+};
+const int rookTable[64] = {
+   0,  0,  0,  5,  5,  0,  0,  0,
+  -5,  0,  0,  0,  0,  0,  0, -5,
+  -5,  0,  0,  0,  0,  0,  0, -5,
+  -5,  0,  0,  0,  0,  0,  0, -5,
+  -5,  0,  0,  0,  0,  0,  0, -5,
+  -5,  0,  0,  0,  0,  0,  0, -5,
+   5, 10, 10, 10, 10, 10, 10,  5,
+   0,  0,  0,  0,  0,  0,  0,  0
+};
+const int queenTable[64] = {
+ -20,-10,-10, -5, -5,-10,-10,-20,
+ -10,  0,  5,  0,  0,  0,  0,-10,
+ -10,  5,  5,  5,  5,  5,  0,-10,
+   0,  0,  5,  5,  5,  5,  0, -5,
+  -5,  0,  5,  5,  5,  5,  0, -5,
+ -10,  0,  5,  5,  5,  5,  0,-10,
+ -10,  0,  0,  0,  0,  0,  0,-10,
+ -20,-10,-10, -5, -5,-10,-10,-20
+};
+const int kingTable[64] = {
+  20, 30, 10,  0,  0, 10, 30, 20,
+  20, 20,  0,  0,  0,  0, 20, 20,
+ -10,-20,-20,-20,-20,-20,-20,-10,
+ -20,-30,-30,-40,-40,-30,-30,-20,
+ -30,-40,-40,-50,-50,-40,-40,-30,
+ -30,-40,-40,-50,-50,-40,-40,-30,
+ -30,-40,-40,-50,-50,-40,-40,-30,
+ -30,-40,-40,-50,-50,-40,-40,-30
+};
+const int *pieceTables[6] = {pawnTable, bishopTable, knightTable, rookTable, queenTable, kingTable};
+const int passedBonus[8] = {0, 10, 15, 25, 40, 65, 100, 0};
+
+const u64 FILE_H = 0x0101010101010101ull;
+const u64 FILE_A = FILE_H << 7;
+const u64 RANK_2 = 0xFFull << 8;
+const u64 RANK_3 = 0xFFull << 16;
+const u64 RANK_6 = 0xFFull << 40;
+const u64 RANK_7 = 0xFFull << 48;
+
+//the weight groups in file order, with their sizes
+struct WeightGroup{
+  char const *name;
+  int start;
+  int size;
+};
+const WeightGroup weightGroups[] = {
+  {"pieceValues", W_PIECE_VALUES, 6},
+  {"pawnTable", W_PIECE_TABLES + PAWN*64, 64}, {"bishopTable", W_PIECE_TABLES + BISHOP*64, 64},
+  {"knightTable", W_PIECE_TABLES + KNIGHT*64, 64}, {"rookTable", W_PIECE_TABLES + ROOK*64, 64},
+  {"queenTable", W_PIECE_TABLES + QUEEN*64, 64}, {"kingTable", W_PIECE_TABLES + KING*64, 64},
+  {"passed", W_PASSED, 8}, {"isolated", W_ISOLATED, 1}, {"doubled", W_DOUBLED, 1}, {"backward", W_BACKWARD, 1},
+  {"shieldSecond", W_SHIELD_SECOND, 1}, {"shieldThird", W_SHIELD_THIRD, 1}, {"freePasser", W_FREE_PASSER, 1},
+  {"outpost", W_OUTPOST, 1}
+};
+
+bool setDefaultWeights(){
+  for(int piece = PAWN; piece<=KING; piece++){
+    evalWeights[W_PIECE_VALUES + piece] = pieceValues[piece];
+    for(int square = 0; square<64; square++) evalWeights[W_PIECE_TABLES + piece*64 + square] = pieceTables[piece][square];
+  }
+  for(int rank = 0; rank<8; rank++) evalWeights[W_PASSED + rank] = passedBonus[rank];
+  evalWeights[W_ISOLATED] = -15;
+  evalWeights[W_DOUBLED] = -12;
+  evalWeights[W_BACKWARD] = -10;
+  evalWeights[W_SHIELD_SECOND] = 10;
+  evalWeights[W_SHIELD_THIRD] = 5;
+  evalWeights[W_FREE_PASSER] = 10;
+  evalWeights[W_OUTPOST] = 15;
+  return true;
+}
+}
+
+int evalWeights[EVAL_WEIGHTS];
+static bool defaultsSet = setDefaultWeights();
+
+char const *evalWeightName(int index){
+  for(WeightGroup const &group : weightGroups){
+    if(index >= group.start && index < group.start + group.size) return group.name;
+  }
+  return "";
+}
+
+bool loadEvalWeights(std::string const &path){
+  std::ifstream in(path);
+  if(!in.is_open()){
+    std::cout<<"[error] Could not open "<<path<<std::endl;
+    return false;
+  }
+  int loaded[EVAL_WEIGHTS];
+  std::copy(evalWeights, evalWeights+EVAL_WEIGHTS, loaded);
+  std::string name;
+  while(in>>name){
+    WeightGroup const *group = nullptr;
+    for(WeightGroup const &g : weightGroups) if(name == g.name) group = &g;
+    if(!group){
+      std::cout<<"[error] Unknown evaluation weights "<<name<<" in "<<path<<std::endl;
+      return false;
+    }
+    for(int i = 0; i<group->size; i++){
+      if(!(in>>loaded[group->start + i])){
+        std::cout<<"[error] "<<path<<" has too few values for "<<name<<std::endl;
+        return false;
+      }
+    }
+  }
+  std::copy(loaded, loaded+EVAL_WEIGHTS, evalWeights);
+  return true;
+}
+
+bool saveEvalWeights(std::string const &path, int const *weights){
+  std::ofstream out(path, std::ofstream::out | std::ofstream::trunc);
+  for(WeightGroup const &group : weightGroups){
+    out<<group.name;
+    for(int i = 0; i<group.size; i++) out<<(group.size == 64 && i%8 == 0 ? "\n " : " ")<<weights[group.start + i];
+    out<<"\n";
+  }
+  out.close();
+  if(out.fail()){
+    std::cout<<"[error] Could not write "<<path<<std::endl;
+    return false;
+  }
+  return true;
+}
+
+int Search::pieceValue(byte piece){
+  return piece == EMPTY ? 0 : pieceValues[piece%6];
+}
+
+namespace{
+//white pawns move towards higher squares, file index 0 is the h file
+u64 northFill(u64 bb){
+  bb |= bb << 8;
+  bb |= bb << 16;
+  return bb | bb << 32;
+}
+u64 southFill(u64 bb){
+  bb |= bb >> 8;
+  bb |= bb >> 16;
+  return bb | bb >> 32;
+}
+//one file over on either side, without wrapping between the a and h files
+u64 adjacentFiles(u64 bb){
+  return ((bb << 1) & ~FILE_H) | ((bb >> 1) & ~FILE_A);
+}
+
+//counts of the pawn structure features of one side, shared by the evaluation and the tuner's features
+struct PawnCounts{
+  u64 passed;
+  u64 attacks;
+  u64 attackSpan;
+  int passedByRank[8];
+  int isolated;
+  int doubled;
+  int backward;
+  int shieldSecond[8];//by king file
+  int shieldThird[8];
+};
+
+void countPawns(u64 white, u64 black, PawnCounts counts[2]){
+  u64 pawns[2] = {white, black};
+  u64 attacks[2] = {shift<8>(adjacentFiles(white)), shift<-8>(adjacentFiles(black))};
+  u64 spans[2] = {northFill(attacks[0]), southFill(attacks[1])};
+  //squares behind each side's pawns on their own files
+  u64 behind[2] = {southFill(white >> 8), northFill(black << 8)};
+  for(int side = 0; side<2; side++){
+    PawnCounts &c = counts[side];
+    u64 own = pawns[side];
+    u64 enemy = pawns[side^1];
+    u64 files = northFill(own) | southFill(own);
+    u64 passed = own & ~(side == 0 ? southFill(enemy >> 8) : northFill(enemy << 8)) & ~spans[side^1] & ~behind[side];
+    u64 isolated = own & ~adjacentFiles(files);
+    //no pawn beside or behind on a neighbouring file can defend it, and its stop square is attacked
+    u64 supportable = side == 0 ? northFill(adjacentFiles(own)) : southFill(adjacentFiles(own));
+    u64 stops = side == 0 ? own << 8 : own >> 8;
+    u64 backward = own & ~isolated & ~supportable & (side == 0 ? (stops & attacks[1]) >> 8 : (stops & attacks[0]) << 8);
+    c.passed = passed;
+    c.attacks = attacks[side];
+    c.attackSpan = spans[side];
+    for(int rank = 0; rank<8; rank++) c.passedByRank[rank] = 0;
+    while(passed){
+      int square = popLsb(passed);
+      c.passedByRank[side == 0 ? square/8 : 7-square/8]++;
+    }
+    c.isolated = popcount(isolated);
+    c.doubled = popcount(own & behind[side]);
+    c.backward = popcount(backward);
+    //own pawns on the king's file and the ones beside it
+    u64 second = side == 0 ? RANK_2 : RANK_7;
+    u64 third = side == 0 ? RANK_3 : RANK_6;
+    for(int file = 0; file<8; file++){
+      u64 zone = (FILE_H << file) | adjacentFiles(FILE_H << file);
+      c.shieldSecond[file] = popcount(own & zone & second);
+      c.shieldThird[file] = popcount(own & zone & third);
+    }
+  }
+}
+
+//fills in everything that only depends on the pawns
+void evaluatePawns(u64 white, u64 black, PawnEntry &entry){
+  PawnCounts counts[2];
+  countPawns(white, black, counts);
+  int score[2] = {0, 0};
+  for(int side = 0; side<2; side++){
+    PawnCounts const &c = counts[side];
+    entry.passed[side] = c.passed;
+    entry.attacks[side] = c.attacks;
+    entry.attackSpans[side] = c.attackSpan;
+    for(int rank = 0; rank<8; rank++) score[side] += evalWeights[W_PASSED + rank]*c.passedByRank[rank];
+    score[side] += evalWeights[W_ISOLATED]*c.isolated + evalWeights[W_DOUBLED]*c.doubled + evalWeights[W_BACKWARD]*c.backward;
+    for(int file = 0; file<8; file++){
+      entry.shield[side][file] = evalWeights[W_SHIELD_SECOND]*c.shieldSecond[file] + evalWeights[W_SHIELD_THIRD]*c.shieldThird[file];
+    }
+  }
+  entry.score = score[0] - score[1];
+}
+}
+
+PawnEntry const &Search::pawnStructure(Position const &board){
+  if(!evalCaching){
+    evaluatePawns(board.bitboard(WHITE+PAWN), board.bitboard(BLACK+PAWN), pawnScratch);
+    return pawnScratch;
+  }
+  evalStats.pawnProbes++;
+  bool hit;
+  PawnEntry &entry = pawnTable.probe(board.pawnHash(), hit);
+  if(hit){
+    evalStats.pawnHits++;
+    return entry;
+  }
+  entry.key = board.pawnHash();
+  evaluatePawns(board.bitboard(WHITE+PAWN), board.bitboard(BLACK+PAWN), entry);
+  return entry;
+}
+
+//material, piece squares and pawn structure, from white's point of view
+int Search::computeEvaluation(Position const &board){
+  int score = 0;
+  for(int piece = PAWN; piece<=KING; piece++){
+    int const *table = evalWeights + W_PIECE_TABLES + piece*64;
+    int value = evalWeights[W_PIECE_VALUES + piece];
+    u64 white = board.bitboard(WHITE+piece);
+    while(white){
+      int square = popLsb(white);
+      score += value + table[square];
+    }
+    u64 black = board.bitboard(BLACK+piece);
+    while(black){
+      int square = popLsb(black);
+      score -= value + table[square^56];
+    }
+  }
+  PawnEntry const &pawns = pawnStructure(board);
+  score += pawns.score;
+  int whiteKing = lsb(board.bitboard(WHITE+KING));
+  int blackKing = lsb(board.bitboard(BLACK+KING));
+  if(whiteKing < 16) score += pawns.shield[0][whiteKing%8];
+  if(blackKing >= 48) score -= pawns.shield[1][blackKing%8];
+  //passed pawns with nothing in the square in front of them
+  u64 occupied = board.occupancy();
+  score += evalWeights[W_FREE_PASSER]*(popcount(pawns.passed[0] & ~(occupied >> 8)) - popcount(pawns.passed[1] & ~(occupied << 8)));
+  //knights defended by a pawn where no enemy pawn can ever attack them
+  u64 whiteOutposts = board.bitboard(WHITE+KNIGHT) & pawns.attacks[0] & ~pawns.attackSpans[1];
+  u64 blackOutposts = board.bitboard(BLACK+KNIGHT) & pawns.attacks[1] & ~pawns.attackSpans[0];
+  score += evalWeights[W_OUTPOST]*(popcount(whiteOutposts) - popcount(blackOutposts));
+  return score;
+}
+
+//the same terms as computeEvaluation as counts, sum(evalWeights[index]*count) is the evaluation from white's point of view
+void Search::evaluationFeatures(Position const &board, std::vector<EvalFeature> &features){
+  int counts[EVAL_WEIGHTS] = {};
+  for(int piece = PAWN; piece<=KING; piece++){
+    u64 white = board.bitboard(WHITE+piece);
+    u64 black = board.bitboard(BLACK+piece);
+    counts[W_PIECE_VALUES + piece] += popcount(white) - popcount(black);
+    while(white) counts[W_PIECE_TABLES + piece*64 + popLsb(white)]++;
+    while(black) counts[W_PIECE_TABLES + piece*64 + (popLsb(black)^56)]--;
+  }
+  PawnCounts pawns[2];
+  countPawns(board.bitboard(WHITE+PAWN), board.bitboard(BLACK+PAWN), pawns);
+  for(int side = 0; side<2; side++){
+    int sign = side == 0 ? 1 : -1;
+    for(int rank = 0; rank<8; rank++) counts[W_PASSED + rank] += sign*pawns[side].passedByRank[rank];
+    counts[W_ISOLATED] += sign*pawns[side].isolated;
+    counts[W_DOUBLED] += sign*pawns[side].doubled;
+    counts[W_BACKWARD] += sign*pawns[side].backward;
+  }
+  int whiteKing = lsb(board.bitboard(WHITE+KING));
+  int blackKing = lsb(board.bitboard(BLACK+KING));
+  if(whiteKing < 16){
+    counts[W_SHIELD_SECOND] += pawns[0].shieldSecond[whiteKing%8];
+    counts[W_SHIELD_THIRD] += pawns[0].shieldThird[whiteKing%8];
+  }
+  if(blackKing >= 48){
+    counts[W_SHIELD_SECOND] -= pawns[1].shieldSecond[blackKing%8];
+    counts[W_SHIELD_THIRD] -= pawns[1].shieldThird[blackKing%8];
+  }
+  u64 occupied = board.occupancy();
+  counts[W_FREE_PASSER] += popcount(pawns[0].passed & ~(occupied >> 8)) - popcount(pawns[1].passed & ~(occupied << 8));
+  counts[W_OUTPOST] += popcount(board.bitboard(WHITE+KNIGHT) & pawns[0].attacks & ~pawns[1].attackSpan);
+  counts[W_OUTPOST] -= popcount(board.bitboard(BLACK+KNIGHT) & pawns[1].attacks & ~pawns[0].attackSpan);
+  for(int i = 0; i<EVAL_WEIGHTS; i++){
+    if(counts[i]) features.push_back({(unsigned short)i, (short)counts[i]});
+  }
+}
+
+//from the point of view of the side to move, through the eval cache
+//one call in EVAL_SAMPLE_MASK+1 is timed so the cost per call can be reported
+int Search::evaluate(Position const &board){
+  bool timed = (evalStats.calls++ & EVAL_SAMPLE_MASK) == 0;
+  auto start = timed ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+  int score;
+  if(evalCaching && evalCache.probe(board.hash(), score)){
+    evalStats.cacheHits++;
+  }else{
+    score = computeEvaluation(board);
+    if(!(board.flags & WHITE_TO_MOVE_BIT)) score = -score;
+    if(evalCaching) evalCache.store(board.hash(), score);
+  }
+  if(timed){
+    evalStats.sampledCalls++;
+    evalStats.sampledNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-start).count();
+  }
+  return score;
+}
+
+//the same random positions evaluated with and without the caches, then the selective search on the bench positions
+//positions from games repeat pawn structures the way a search does, so the pawn table hit rate is realistic
+void Search::runEvalBench(){
+  std::vector<Position> positions = randomGamePositions(100000);
+  if(!tt) tt = std::make_shared<TranspositionTable>();
+  bool caching = evalCaching;
+  std::shared_ptr<const OpeningBook> savedBook = book;
+  book = nullptr;
+  u64 checksums[2] = {};
+  for(int cached = 0; cached<2; cached++){
+    evalCaching = cached;
+    pawnTable.clear();
+    evalCache.clear();
+    evalStats = EvalStats();
+    auto start = std::chrono::high_resolution_clock::now();
+    for(Position const &p : positions) checksums[cached] = checksums[cached]*31 + evaluate(p);
+    u64 ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now()-start).count();
+    std::cout<<(cached ? "Cached  " : "Uncached")<<" eval   : "<<ns/positions.size()<<" ns/call, pawn hash hits "<<evalStats.pawnHitRate()*100<<"%\n";
+
+    evalStats = EvalStats();
+    Board board;
+    u64 totalNodes = 0;
+    start = std::chrono::high_resolution_clock::now();
+    for(BenchPosition const &position : benchPositions){
+      board.loadFromFEN(position.fen);
+      tt->clear();
+      int score;
+      searchBestMove(board, 7, 0, score);
+      totalNodes += nodes;
+    }
+    ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now()-start).count();
+    std::cout<<(cached ? "Cached  " : "Uncached")<<" search : "<<totalNodes*1000000000/(ns ? ns : 1)<<" nodes/s, "<<evalStats.calls<<" evals, ";
+    std::cout<<evalStats.nsPerCall()<<" ns/eval, eval cache hits "<<evalStats.cacheHitRate()*100<<"%, pawn hash hits "<<evalStats.pawnHitRate()*100<<"%"<<std::endl;
+  }
+  if(checksums[0] != checksums[1]) std::cout<<"\x1b[31m[error] cached and uncached evaluations differ\x1b[0m"<<std::endl;
+  evalCaching = caching;
+  book = savedBook;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <vector>
+
+#include "../../Board/board.h"
+
+#define PAWN_HASH_ENTRIES 16384//about 1.6MB
+#define EVAL_CACHE_ENTRIES 16384//256KB
+#define EVAL_SAMPLE_MASK 255//one call in 256 is timed for eval ns/call
+
+//pawn structure terms and the bitboards derived from the pawns, everything in it depends only on the pawns
+//scores are from white's point of view, index 0 is white
+struct PawnEntry{
+  u64 key;
+  u64 passed[2];//passed pawns, the rear pawn of a doubled pair is not passed
+  u64 attacks[2];//squares the pawns attack now
+  u64 attackSpans[2];//squares the pawns could ever attack by advancing
+  short score;//passed, isolated, doubled and backward pawns
+  short shield[2][8];//pawn shield bonus with the king on its first two ranks, by the king's file
+};
+
+//keyed by Position::pawnHash(), pawn structures repeat so much in a search that most probes hit
+class PawnHashTable{
+  std::vector<PawnEntry> entries = std::vector<PawnEntry>(PAWN_HASH_ENTRIES, PawnEntry{});
+public:
+  //hit is false when the entry was for other pawns and has to be filled in
+  PawnEntry &probe(u64 key, bool &hit){
+    PawnEntry &entry = entries[key & (PAWN_HASH_ENTRIES-1)];
+    hit = entry.key == key;
+    return entry;
+  }
+  void clear(){std::fill(entries.begin(), entries.end(), PawnEntry{});}
+};
+
+//full evaluations by position hash, the score is for the side to move (the side is in the key)
+class EvalCache{
+  struct Entry{
+    u64 key;
+    int score;
+  };
+  std::vector<Entry> entries = std::vector<Entry>(EVAL_CACHE_ENTRIES, Entry{});
+public:
+  bool probe(u64 key, int &score) const{
+    Entry const &entry = entries[key & (EVAL_CACHE_ENTRIES-1)];
+    score = entry.score;
+    return entry.key == key && key != 0;
+  }
+  void store(u64 key, int score){entries[key & (EVAL_CACHE_ENTRIES-1)] = {key, score};}
+  void clear(){std::fill(entries.begin(), entries.end(), Entry{});}
+};
+
+//counters of one search object, added together by whoever reports them
+struct EvalStats{
+  u64 calls = 0;
+  u64 cacheHits = 0;
+  u64 pawnProbes = 0;//only calls that missed the eval cache probe the pawn table
+  u64 pawnHits = 0;
+  u64 sampledCalls = 0;
+  u64 sampledNs = 0;
+  EvalStats &operator+=(EvalStats const &other){
+    calls += other.calls;
+    cacheHits += other.cacheHits;
+    pawnProbes += other.pawnProbes;
+    pawnHits += other.pawnHits;
+    sampledCalls += other.sampledCalls;
+    sampledNs += other.sampledNs;
+    return *this;
+  }
+  float cacheHitRate() const {return calls ? (float)cacheHits/calls : 0;}
+  float pawnHitRate() const {return pawnProbes ? (float)pawnHits/pawnProbes : 0;}
+  u64 nsPerCall() const {return sampledCalls ? sampledNs/sampledCalls : 0;}
+};
@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+
+#include "../../Board/Bitboards/bitboard.h"
+
+//every evaluation weight in one flat array, so the tuner can treat them as one vector
+//the evaluation is linear in them: the score is the sum of weight*count over the features of the position
+#define W_PIECE_VALUES  0//6, by piece type
+#define W_PIECE_TABLES  6//6*64, from white's point of view, index 0 is h1
+#define W_PASSED        390//8, by rank counted from the pawn's own side
+#define W_ISOLATED      398
+#define W_DOUBLED       399
+#define W_BACKWARD      400
+#define W_SHIELD_SECOND 401//per pawn in front of the king, one rank ahead of the first rank
+#define W_SHIELD_THIRD  402
+#define W_FREE_PASSER   403//passed pawn with an empty square in front
+#define W_OUTPOST       404//knight defended by a pawn that no enemy pawn can attack
+#define EVAL_WEIGHTS    405
+
+extern int evalWeights[EVAL_WEIGHTS];//starts with the hand written values in eval.cpp
+char const *evalWeightName(int index);//the group the weight belongs to
+//text file of "name value value ..." lines in the order above, written by the tuner
+bool loadEvalWeights(std::string const &path);
+bool saveEvalWeights(std::string const &path, int const *weights);
+
+//one nonzero count of a position, white's pieces count positive
+struct EvalFeature{
+  unsigned short index;
+  short count;
+};
@@ -0,0 +1,213 @@
+#include "positioncache.h"
+#include "tt.h"
+#include "../search.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define POSITION_CACHE_VERSION 3//bumped whenever the evaluation code or the file layout changes, old scores are not comparable
+#define BUCKET_ENTRIES 4
+
+namespace{
+struct PositionCacheHeader{
+  char id[8];//"CHSPOSC"
+  unsigned int version;
+  unsigned int headerSize;
+  u64 bucketCount;
+  u64 entryWords;
+  u64 fingerprint;//Search::scoreFingerprint() of the process that created it
+  u64 checksum;//of the fields above
+  u64 padding[2];//entries start on a cache line
+};
+static_assert(sizeof(PositionCacheHeader) == 64, "header should be one cache line");
+
+inline void mix(u64 &hash, u64 value){
+  hash ^= value;
+  hash *= 0x100000001b3ull;
+  hash ^= hash>>29;
+}
+
+u64 headerChecksum(PositionCacheHeader const &h){
+  u64 hash = 0xcbf29ce484222325ull;
+  u64 fields[5] = {h.version, h.headerSize, h.bucketCount, h.entryWords, h.fingerprint};
+  for(u64 f : fields) mix(hash, f);
+  return hash;
+}
+
+//data word: move 0-15, score 16-31, depth 32-39, flag 40-41, has search 42, perft depth 48-55
+u64 packData(PositionCache::Result const &r){
+  return (u64)r.move.getMoveData() | (u64)(unsigned short)r.score<<16 | (u64)r.depth<<32 | (u64)(r.flag&3)<<40
+       | (u64)r.hasSearch<<42 | (u64)r.perftDepth<<48;
+}
+
+PositionCache::Result unpackData(u64 data, u64 perft){
+  PositionCache::Result r;
+  r.move = Move((unsigned short)data);
+  r.score = (short)(data>>16);
+  r.depth = data>>32;
+  r.flag = (data>>40)&3;
+  r.hasSearch = (data>>42)&1;
+  r.perftDepth = data>>48;
+  r.perftNodes = perft;
+  return r;
+}
+
+//other processes write the same pages, the words are read and written one at a time
+inline u64 loadWord(u64 const *p){return __atomic_load_n(p, __ATOMIC_RELAXED);}
+inline void storeWord(u64 *p, u64 value){__atomic_store_n(p, value, __ATOMIC_RELAXED);}
+}
+
+//the tt scores are only valid for the weights and pruning that produced them, perft counts would be fine but share the file
+u64 Search::scoreFingerprint() const{
+  u64 hash = 0xcbf29ce484222325ull;
+  for(int w = 0; w<EVAL_WEIGHTS; w++) mix(hash, (unsigned int)evalWeights[w]);
+  mix(hash, (u64)features.principalVariation | (u64)features.nullMove<<1 | (u64)features.lateMoveReductions<<2
+          | (u64)features.reverseFutility<<3 | (u64)features.futility<<4 | (u64)features.razoring<<5 | (u64)features.checkExtensions<<6);
+  mix(hash, bitbases != nullptr);
+  return hash;
+}
+
+PositionCache::~PositionCache(){
+  if(mapping) munmap(mapping, mappedLength);
+}
+
+bool PositionCache::map(int fd, u64 length, u64 fingerprint, bool &otherConfig){
+  void *mapped = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if(mapped == MAP_FAILED) return false;
+  PositionCacheHeader header;
+  std::memcpy(&header, mapped, sizeof(header));
+  otherConfig = header.checksum == headerChecksum(header) && header.fingerprint != fingerprint;
+  if(otherConfig || std::memcmp(header.id, "CHSPOSC", 8) != 0
+     || header.version != POSITION_CACHE_VERSION
+     || header.headerSize != sizeof(PositionCacheHeader)
+     || header.entryWords != 4
+     || header.checksum != headerChecksum(header)
+     || length != sizeof(PositionCacheHeader) + header.bucketCount*BUCKET_ENTRIES*32){
+    munmap(mapped, length);
+    return false;
+  }
+  mapping = mapped;
+  mappedLength = length;
+  bucketCount = header.bucketCount;
+  entries = (u64 *)((char *)mapped + sizeof(PositionCacheHeader));
+  return true;
+}
+
+//built under a temporary name and linked into place, if another process created the file first that one is used
+bool PositionCache::create(int megabytes, u64 fingerprint){
+  u64 buckets = 1;
+  while(buckets*2*BUCKET_ENTRIES*32 <= (u64)megabytes*1024*1024) buckets *= 2;
+  std::string temp = path + ".tmp" + std::to_string(getpid());
+  int fd = ::open(temp.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if(fd < 0) return false;
+  PositionCacheHeader header = {};
+  std::memcpy(header.id, "CHSPOSC", 8);
+  header.version = POSITION_CACHE_VERSION;
+  header.headerSize = sizeof(PositionCacheHeader);
+  header.bucketCount = buckets;
+  header.entryWords = 4;
+  header.fingerprint = fingerprint;
+  header.checksum = headerChecksum(header);
+  bool written = ftruncate(fd, sizeof(header) + buckets*BUCKET_ENTRIES*32) == 0//the entries read back as zero
+              && pwrite(fd, &header, sizeof(header), 0) == sizeof(header);
+  close(fd);
+  if(!written || link(temp.c_str(), path.c_str()) != 0){
+    unlink(temp.c_str());
+    return errno == EEXIST;
+  }
+  unlink(temp.c_str());
+  return true;
+}
+
+bool PositionCache::open(std::string const &cachePath, u64 fingerprint, int megabytes){
+  path = cachePath;
+  for(int attempt = 0; attempt<2; attempt++){
+    int fd = ::open(path.c_str(), O_RDWR);
+    if(fd >= 0){
+      struct stat st;
+      bool otherConfig = false;
+      bool mapped = fstat(fd, &st) == 0 && (u64)st.st_size >= sizeof(PositionCacheHeader) && map(fd, st.st_size, fingerprint, otherConfig);
+      close(fd);//the mapping stays valid
+      if(mapped) return true;
+      //processes still using the old file keep their mapping of it
+      if(otherConfig) std::cout<<"[warning] "<<path<<" was written with other eval weights, search features or bitbases, recreating it"<<std::endl;
+      else std::cout<<"[warning] "<<path<<" is not a valid position cache, recreating it"<<std::endl;
+      unlink(path.c_str());
+    }
+    if(!create(megabytes, fingerprint)){
+      std::cout<<"[error] Could not create "<<path<<std::endl;
+      return false;
+    }
+  }
+  return false;
+}
+
+bool PositionCache::probe(u64 key, Result &result) const{
+  u64 const *bucket = entries + (key & (bucketCount-1))*BUCKET_ENTRIES*4;
+  for(int i = 0; i<BUCKET_ENTRIES; i++){
+    u64 const *e = bucket + i*4;
+    u64 check = loadWord(e), perft = loadWord(e+1), data = loadWord(e+2), spare = loadWord(e+3);
+    if((check ^ perft ^ data ^ spare) != key || (data == 0 && perft == 0)) continue;
+    result = unpackData(data, perft);
+    hits++;
+    return true;
+  }
+  return false;
+}
+
+void PositionCache::store(u64 key, Result const &result){
+  u64 *bucket = entries + (key & (bucketCount-1))*BUCKET_ENTRIES*4;
+  u64 *target = nullptr;
+  int targetDepth = 256;
+  for(int i = 0; i<BUCKET_ENTRIES; i++){
+    u64 *e = bucket + i*4;
+    u64 check = loadWord(e), perft = loadWord(e+1), data = loadWord(e+2), spare = loadWord(e+3);
+    if((check ^ perft ^ data ^ spare) == key){
+      target = e;
+      break;
+    }
+    //empty entries have no depth, so they go first
+    Result r = unpackData(data, perft);
+    int depth = (check | perft | data) == 0 ? -1 : std::max(r.hasSearch ? r.depth : 0, (int)r.perftDepth);
+    if(depth < targetDepth){
+      target = e;
+      targetDepth = depth;
+    }
+  }
+  u64 perft = result.perftNodes;
+  u64 data = packData(result);
+  storeWord(target+1, perft);
+  storeWord(target+2, data);
+  storeWord(target+3, 0);
+  storeWord(target, key ^ perft ^ data);
+  stores++;
+}
+
+void PositionCache::storeSearch(u64 key, int depth, int score, int flag, Move move){
+  Result r = {};
+  if(probe(key, r)){
+    hits--;
+    if(r.hasSearch && r.depth > depth) return;
+  }
+  r.hasSearch = true;
+  r.move = move;
+  r.score = score;
+  r.depth = depth;
+  r.flag = flag;
+  store(key, r);
+}
+
+void PositionCache::storePerft(u64 key, int depth, u64 nodes){
+  Result r = {};
+  if(probe(key, r)){
+    hits--;
+    if(r.perftDepth > depth) return;
+  }
+  r.perftDepth = depth;
+  r.perftNodes = nodes;
+  store(key, r);
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <atomic>
+#include <string>
+
+#include "../../Board/board.h"
+
+#define POSITION_CACHE_MIN_DEPTH 3//shallower results are cheaper to redo than to write to the file
+
+//Search results and perft counts keyed by position hash, in a file mapped read/write and shared by every process that opens it
+//The file is a header and buckets of 4 entries of 4 u64s, the first word is the key xored with the other three,
+//so an entry torn by two writers at once (or damaged on disk) just fails to match its key, no locks are needed
+//A new result replaces the same position, then an empty entry, then the shallowest one in the bucket
+//The header keeps the Search::scoreFingerprint() the scores were searched with, a file from another configuration is recreated
+class PositionCache{
+public:
+  struct Result{
+    bool hasSearch;
+    Move move;
+    short score;//stored relative to the node, see scoreFromTT
+    byte depth;
+    byte flag;//TT_EXACT, TT_LOWER or TT_UPPER
+    byte perftDepth;//0 if there is no perft count
+    u64 perftNodes;
+  };
+private:
+  u64 *entries = nullptr;//4 words per entry
+  u64 bucketCount = 0;
+  void *mapping = nullptr;
+  u64 mappedLength = 0;
+  std::string path;
+
+  bool map(int fd, u64 length, u64 fingerprint, bool &otherConfig);
+  bool create(int megabytes, u64 fingerprint);
+  void store(u64 key, Result const &result);
+public:
+  mutable std::atomic<u64> hits{0};
+  std::atomic<u64> stores{0};
+
+  PositionCache(){}
+  PositionCache(PositionCache const &) = delete;
+  ~PositionCache();
+  bool open(std::string const &path, u64 fingerprint, int megabytes = 64);//creates the file if it is missing, invalid or from another configuration
+  bool probe(u64 key, Result &result) const;
+  void storeSearch(u64 key, int depth, int score, int flag, Move move);//keeps the perft count, a shallower search does not replace a deeper one
+  void storePerft(u64 key, int depth, u64 nodes);//keeps the search result
+  u64 size() const {return mappedLength;}
+};
@@ -0,0 +1,59 @@
+#include "tt.h"
+#include "../search.h"
+
+static_assert(sizeof(TranspositionTable::Entry) == 16, "entries should stay 16 bytes");
+
+void TranspositionTable::resize(int megabytes){
+  u64 count = 1;
+  while(count*2*sizeof(Entry) <= (u64)megabytes*1024*1024) count *= 2;
+  memory.reset();//the old table is freed first
+  memory = allocateLarge(count*sizeof(Entry), backing);
+  entries = (Entry *)memory.get();//zeroed, an empty entry has key 0
+  mask = count-1;
+}
+
+void TranspositionTable::clear(){
+  std::fill(entries, entries+mask+1, Entry{});
+  generation = 0;
+}
+
+int scoreToTT(int score, int ply){
+  if(score > MATE_SCORE - MAX_SEARCH_PLY) return score + ply;
+  if(score < -MATE_SCORE + MAX_SEARCH_PLY) return score - ply;
+  return score;
+}
+
+int scoreFromTT(int score, int ply){
+  if(score > MATE_SCORE - MAX_SEARCH_PLY) return score - ply;
+  if(score < -MATE_SCORE + MAX_SEARCH_PLY) return score + ply;
+  return score;
+}
+
+bool TranspositionTable::probe(u64 key, Entry &entry, int ply) const{
+  entry = entries[key & mask];
+  if(entry.key != key) return false;
+  entry.score = scoreFromTT(entry.score, ply);
+  return true;
+}
+
+void TranspositionTable::store(u64 key, int depth, int score, int flag, Move move, int ply){
+  Entry &entry = entries[key & mask];
+  if(entry.key == key || entry.generation != generation || depth >= entry.depth){
+    if(entry.key == key && move.getMoveData() == 0) move = entry.move;//keep the old best move for ordering
+    entry.key = key;
+    entry.move = move;
+    entry.score = scoreToTT(score, ply);
+    entry.depth = depth;
+    entry.flag = flag;
+    entry.generation = generation;
+  }
+}
+
+int TranspositionTable::hashfull() const{
+  int used = 0;
+  int count = mask+1 < 1000 ? mask+1 : 1000;
+  for(int i = 0; i<count; i++){
+    if(entries[i].key != 0 && entries[i].generation == generation) used++;
+  }
+  return count ? used*1000/count : 0;
+}
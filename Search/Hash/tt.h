@@ -0,0 +1,42 @@
+#pragma once
+#include <memory>
+
+#include "../../Board/board.h"
+#include "../Memory/largepages.h"
+
+#define TT_EXACT 0
+#define TT_LOWER 1//score is at least this (failed high)
+#define TT_UPPER 2//score is at most this (failed low)
+
+//mates are stored as the distance from the stored node instead of from the root
+int scoreToTT(int score, int ply);
+int scoreFromTT(int score, int ply);
+
+//Transposition table, one 16 byte entry per bucket, allocated with huge pages when the system has them, replaced when the new search is as deep or from a newer search
+//Mate scores are stored relative to the entry's own ply, so they stay correct when found through another path
+class TranspositionTable{
+public:
+  struct Entry{
+    u64 key;
+    Move move;
+    short score;
+    byte depth;
+    byte flag;
+    byte generation;
+  };
+private:
+  std::shared_ptr<void> memory;
+  Entry *entries = nullptr;
+  u64 mask = 0;
+  byte generation = 0;
+public:
+  TranspositionTable(int megabytes = 16){resize(megabytes);}
+  void resize(int megabytes);//rounded down to a power of two entries
+  void clear();
+  void newSearch(){generation++;}
+  bool probe(u64 key, Entry &entry, int ply) const;//entry.score is adjusted to ply
+  void store(u64 key, int depth, int score, int flag, Move move, int ply);
+  PageBacking backing = PAGES_NORMAL;
+  u64 size() const {return (mask+1)*sizeof(Entry);}//in bytes
+  int hashfull() const;//permille of the first 1000 entries used by the current search
+};
@@ -0,0 +1,123 @@
+#include "../search.h"
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//Binary cache of the slider tables, mapped read only so every process on the machine shares the same pages
+//layout: header, rook masks, bishop masks, rook magics, bishop magics, rook shifts, bishop shifts,
+//rook offsets, bishop offsets, table
+#define ATTACK_CACHE_VERSION 1
+
+namespace {
+struct AttackCacheHeader{
+  char id[8];//"CHSATTK"
+  unsigned int version;
+  unsigned int headerSize;
+  u64 tableSize;//in entries
+  u64 checksum;//of everything after the header
+};
+
+const u64 attackCacheArrays = 8*64;//u64 arrays before the table, shifts are stored as u64 too
+
+u64 checksum(u64 const *data, u64 length){
+  u64 hash = 0xcbf29ce484222325ull;
+  for(u64 i = 0; i<length; i++){
+    hash ^= data[i];
+    hash *= 0x100000001b3ull;
+    hash ^= hash>>29;
+  }
+  return hash;
+}
+}
+
+bool Search::loadAttackCache(){
+  int fd = open(attackCachePath.c_str(), O_RDONLY);
+  if(fd < 0) return false;
+  struct stat st;
+  if(fstat(fd, &st) != 0 || (u64)st.st_size < sizeof(AttackCacheHeader)){
+    close(fd);
+    return false;
+  }
+  u64 length = st.st_size;
+  void *mapped = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);//the mapping stays valid
+  if(mapped == MAP_FAILED) return false;
+  std::shared_ptr<const u64> mapping((u64 const *)mapped, [length](u64 const *p){ munmap((void *)p, length); });
+
+  AttackCacheHeader header;
+  std::memcpy(&header, mapped, sizeof(header));
+  u64 const *data = mapping.get() + sizeof(AttackCacheHeader)/8;
+  u64 dataLength = attackCacheArrays + header.tableSize;
+  if(std::memcmp(header.id, "CHSATTK", 8) != 0
+     || header.version != ATTACK_CACHE_VERSION
+     || header.headerSize != sizeof(AttackCacheHeader)
+     || length != sizeof(AttackCacheHeader) + dataLength*8){
+    std::cout<<"[warning] "<<attackCachePath<<" is not a compatible attack cache, rebuilding"<<std::endl;
+    return false;
+  }
+  if(checksum(data, dataLength) != header.checksum){
+    std::cout<<"[warning] "<<attackCachePath<<" failed its checksum, rebuilding"<<std::endl;
+    return false;
+  }
+  for(int i = 0; i<64; i++){
+    rookMasks[i] = data[i];
+    bishopMasks[i] = data[64+i];
+    rookMagics[i] = data[128+i];
+    bishopMagics[i] = data[192+i];
+    rookShifts[i] = (int)data[256+i];
+    bishopShifts[i] = (int)data[320+i];
+    rookOffsets[i] = data[384+i];
+    bishopOffsets[i] = data[448+i];
+    if(rookOffsets[i] >= header.tableSize || bishopOffsets[i] >= header.tableSize){
+      std::cout<<"[warning] "<<attackCachePath<<" has invalid offsets, rebuilding"<<std::endl;
+      return false;
+    }
+  }
+  //alias the table inside the mapping, the mapping is released with the last copy
+  sliderTable = std::shared_ptr<const u64>(mapping, data + attackCacheArrays);
+  sliderTableSize = header.tableSize;
+  setSliderPointers();
+  return true;
+}
+
+//written to a temporary file and renamed, processes that already mapped the old file keep their pages
+bool Search::saveAttackCache(){
+  std::vector<u64> arrays(attackCacheArrays);
+  for(int i = 0; i<64; i++){
+    arrays[i] = rookMasks[i];
+    arrays[64+i] = bishopMasks[i];
+    arrays[128+i] = rookMagics[i];
+    arrays[192+i] = bishopMagics[i];
+    arrays[256+i] = (u64)rookShifts[i];
+    arrays[320+i] = (u64)bishopShifts[i];
+    arrays[384+i] = rookOffsets[i];
+    arrays[448+i] = bishopOffsets[i];
+  }
+  AttackCacheHeader header;
+  std::memcpy(header.id, "CHSATTK", 8);
+  header.version = ATTACK_CACHE_VERSION;
+  header.headerSize = sizeof(AttackCacheHeader);
+  header.tableSize = sliderTableSize;
+  //checksum runs over the arrays and table as one stream
+  std::vector<u64> data(arrays);
+  data.insert(data.end(), sliderTable.get(), sliderTable.get() + sliderTableSize);
+  header.checksum = checksum(data.data(), data.size());
+
+  std::string temp = attackCachePath + ".tmp";
+  std::ofstream file(temp, std::ofstream::out | std::ofstream::trunc | std::ofstream::binary);
+  if(!file.is_open()){
+    std::cout<<"[error] Could not open "<<temp<<std::endl;
+    return false;
+  }
+  file.write((char const *)&header, sizeof(header));
+  file.write((char const *)data.data(), data.size()*8);
+  file.close();
+  if(file.fail() || std::rename(temp.c_str(), attackCachePath.c_str()) != 0){
+    std::cout<<"[error] Could not write "<<attackCachePath<<std::endl;
+    std::remove(temp.c_str());
+    return false;
+  }
+  return true;
+}
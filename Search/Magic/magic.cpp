@@ -1,18 +1,5 @@
 #include "../search.h"
 
-//random functions from https://www.chessprogramming.org/Looking_for_Magics
-//modified slightly to fit naming convention
-u64 random_uint64() {
-  u64 u1, u2, u3, u4;
-  u1 = (u64)(random()) & 0xFFFF; u2 = (u64)(random()) & 0xFFFF;
-  u3 = (u64)(random()) & 0xFFFF; u4 = (u64)(random()) & 0xFFFF;
-  return u1 | (u2 << 16) | (u3 << 32) | (u4 << 48);
-}
-
-u64 random_u64_fewbits() {
-  return random_uint64() & random_uint64() & random_uint64();
-}
-
 void Search::generateRookBlockers(){
   for(int i = 0; i<64; i++){
     generateBlockersFromMask(rookMasks[i], rookBlockers[i]);
@@ -28,10 +15,10 @@ void Search::generateBishopBlockers(){
 void Search::generateBlockersFromMask(u64 mask,std::vector<u64> &target){
   target.clear();
   u64 bb = mask;
-  int bc = bitcount(bb);
+  int bc = popcount(bb);
   std::vector<int> bitIndices;
   while(bb){
-    bitIndices.push_back(popls1b(bb));
+    bitIndices.push_back(popLsb(bb));
   }
   for(int j = 0; j<pow(2,bc);j++){
     u64 blocker = (u64)0;
@@ -42,97 +29,178 @@ void Search::generateBlockersFromMask(u64 mask,std::vector<u64> &target){
   }
 }
 
-bool Search::testMagic(std::vector<u64> *blockers, int square,u64 magic, int shift){
-  std::map<u64,bool> foundKeys;//map is probably not the best fit here
-  for(u64 blocker : blockers[square]){
-    u64 hashed = u64(blocker*magic)>>shift;
-    if(foundKeys.find(hashed) != foundKeys.end()){
-      return false;
+namespace {
+//xorshift64*, seeded per task so results do not depend on which thread ran which square
+struct MagicRandom{
+  u64 state;
+  MagicRandom(u64 seed) : state(seed ? seed : 0x9E3779B97F4A7C15ull) {}
+  u64 next(){
+    state ^= state>>12;
+    state ^= state<<25;
+    state ^= state>>27;
+    return state * 0x2545F4914F6CDD1Dull;
+  }
+  u64 fewBits(){ return next() & next() & next(); }
+};
+
+struct MagicCandidate{
+  u64 magic = 0;
+  int shift = 0;
+  u64 size = ~(u64)0;//number of table entries actually used (highest key + 1)
+};
+
+struct MagicTask{
+  bool rook;
+  int square;
+  u64 mask;
+  std::vector<u64> blockers;
+  std::vector<u64> moves;//moves for blockers[i]
+  MagicCandidate start;
+  MagicCandidate best;
+};
+
+//flat collision table, an entry is only valid if its epoch matches the current test
+//so nothing has to be cleared between candidates
+struct CollisionTable{
+  std::vector<unsigned> epochs;
+  std::vector<u64> entries;
+  unsigned epoch = 0;
+
+  //returns the used table size, or 0 if two blockers with different moves share a key
+  u64 test(MagicTask const &task, u64 magic, int shift){
+    u64 size = (u64)1<<(64-shift);
+    if(epochs.size() < size){
+      epochs.assign(size, 0);
+      entries.resize(size);
+      epoch = 0;
+    }
+    if(++epoch == 0){
+      std::fill(epochs.begin(), epochs.end(), 0);
+      epoch = 1;
+    }
+    u64 used = 0;
+    for(size_t i = 0; i<task.blockers.size(); i++){
+      u64 key = (task.blockers[i]*magic)>>shift;
+      if(epochs[key] == epoch){
+        if(entries[key] != task.moves[i]) return 0;//destructive collision
+        continue;//constructive collision, same moves
+      }
+      epochs[key] = epoch;
+      entries[key] = task.moves[i];
+      if(key+1 > used) used = key+1;
+    }
+    return used;
+  }
+};
+
+void runMagicTask(MagicTask &task, u64 seed, std::chrono::steady_clock::time_point deadline){
+  CollisionTable table;
+  MagicRandom rng(seed);
+  if(task.best.magic != 0){
+    task.best.size = table.test(task, task.best.magic, task.best.shift);
+    if(task.best.size == 0) task.best = MagicCandidate();
+  }
+  if(task.best.magic == 0){
+    //nothing valid to improve on, start from a table twice the size of the blocker set
+    task.best.shift = 64 - popcount(task.mask) - 1;
+  }
+  task.start = task.best;
+  while(std::chrono::steady_clock::now() < deadline){
+    for(int i = 0; i<1000; i++){
+      u64 magic = rng.fewBits();
+      if(popcount((task.mask*magic) & 0xFF00000000000000ull) < 6) continue;
+      //a larger shift halves the key range, try that first, but the used size is what ranks them
+      //so it is only taken when it is no bigger than the best (the shift then goes up on a tie)
+      if(task.best.magic != 0 && task.best.shift < 63){
+        u64 size = table.test(task, magic, task.best.shift+1);
+        if(size && size <= task.best.size){
+          task.best = {magic, task.best.shift+1, size};
+          continue;
+        }
+      }
+      u64 size = table.test(task, magic, task.best.shift);
+      if(size && size < task.best.size){
+        task.best = {magic, task.best.shift, size};
+      }
     }
-    foundKeys.insert({hashed,true});
   }
-  return true;
+}
 }
 
-//Search can be greatly improved
-// for example, just using the shift values is an innacurate way to estimate the lookup table size
-//and rand is never seeded
-void Search::searchForMagics(){
+//Runs one task per square and piece on a pool of threads, each task gets an equal share of the time budget
+//Table size is measured as the highest key used, not estimated from the shift
+bool Search::searchForMagics(int seconds, int threads, u64 seed){
+  if(threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
   std::cout<<"[generating blockers]\n";
   generateRookBlockers();
   generateBishopBlockers();
-  std::cout<<"[beginning search]\nresume from last time?(Y/n)";
-  std::string temp;
-  std::getline(std::cin, temp);
-  loadMagics();
-  if(temp == "n"){
-    for(int &i : rookShifts){
-      i = -999;
-    }
-    for(int &i : bishopShifts){
-      i = -999;
+  std::vector<MagicTask> tasks(128);
+  for(int i = 0; i<128; i++){
+    MagicTask &task = tasks[i];
+    task.rook = i < 64;
+    task.square = i%64;
+    task.mask = task.rook ? rookMasks[task.square] : bishopMasks[task.square];
+    task.blockers = task.rook ? rookBlockers[task.square] : bishopBlockers[task.square];
+    for(u64 blocker : task.blockers){
+      task.moves.push_back(computeSlidingMoves(task.square, blocker, task.rook));
     }
+    task.best.magic = task.rook ? rookMagics[task.square] : bishopMagics[task.square];
+    task.best.shift = task.rook ? rookShifts[task.square] : bishopShifts[task.square];
   }
-  while(1){
-    for(int attempt = 0; attempt<100; attempt++){
-      for(int square = 0;square<64;square++){
-        u64 magic = random_u64_fewbits();
-        int shift = -999;
-        for(int s = 40; s<64; s++){
-          if(testMagic(rookBlockers, square,magic,s)){shift = s;}
-          else{break;}
-        }
-        if(shift >rookShifts[square]){
-          rookMagics[square] = magic;
-          rookShifts[square] = shift;
-        }
-        shift = -999;
-        for(int s = 40; s<64; s++){
-          if(testMagic(bishopBlockers, square,magic,s)){shift = s;}
-          else{break;}
-        }
-        if(shift >bishopShifts[square]){
-          bishopMagics[square] = magic;
-          bishopShifts[square] = shift;
-        }
-      }
 
-      //print information about search
-      int foundRook = 0;
-      int rookTableSize= 0;
-      int foundBishop = 0;
-      int bishopTableSize= 0;
-      for(int i= 0; i<64; i++){
-        if(rookShifts[i]!= -999)foundRook++;
-        rookTableSize += pow(2,64-rookShifts[i]);
-        if(bishopShifts[i]!= -999)foundBishop++;
-        bishopTableSize += pow(2,64-bishopShifts[i]);
+  std::cout<<"[searching for "<<seconds<<"s on "<<threads<<" threads, seed "<<seed<<"]"<<std::endl;
+  auto slice = std::chrono::milliseconds((u64)seconds*1000*threads/128);
+  std::atomic<int> nextTask(0);
+  std::vector<std::thread> pool;
+  for(int t = 0; t<threads; t++){
+    pool.emplace_back([&](){
+      int i;
+      while((i = nextTask++) < 128){
+        runMagicTask(tasks[i], seed + (u64)i*0x9E3779B97F4A7C15ull, std::chrono::steady_clock::now() + slice);
       }
-      std::cout<<"\nRook magics found for "<<foundRook<<"/64 squares\n";
-      std::cout<<"Rook table ~"<<rookTableSize*8<<" bytes\n";
-      std::cout<<"Bishop magics found for "<<foundBishop<<"/64 squares\n";
-      std::cout<<"Bishop table ~"<<bishopTableSize*8<<" bytes\n";
+    });
+  }
+  for(std::thread &t : pool) t.join();
+
+  u64 before[2] = {0, 0};
+  u64 after[2] = {0, 0};
+  bool changed = false;
+  for(MagicTask &task : tasks){
+    if(task.best.magic == 0){
+      std::cout<<"[error] No magic found for square "<<task.square<<", try a longer search"<<std::endl;
+      return false;
     }
-    std::string temp;
-    std::cout<<"Continue search?(Y/n)\n";
-    std::getline(std::cin, temp);
-    if(temp == "n"){
-      break;
+  }
+  for(MagicTask &task : tasks){
+    before[!task.rook] += task.start.magic ? task.start.size : 0;
+    after[!task.rook] += task.best.size;
+    if(task.best.magic != task.start.magic) changed = true;
+    if(task.rook){
+      rookMagics[task.square] = task.best.magic;
+      rookShifts[task.square] = task.best.shift;
+    }else{
+      bishopMagics[task.square] = task.best.magic;
+      bishopShifts[task.square] = task.best.shift;
     }
   }
-  std::cout<<"Save magics?(y/N)\n";
-  std::getline(std::cin, temp);
-  if(temp == "y"){
-    saveMagics();
+  std::cout<<"Rook table "<<before[0]*8<<" -> "<<after[0]*8<<" bytes\n";
+  std::cout<<"Bishop table "<<before[1]*8<<" -> "<<after[1]*8<<" bytes"<<std::endl;
+  if(!changed){
+    std::cout<<"No improvement found"<<std::endl;
+    return false;
   }
-  loadMagics();
-};
+  if(!saveMagics()) return false;
+  fillSliderMoves();
+  if(attackCachePath != "") saveAttackCache();
+  return true;
+}
 
-void Search::saveMagics(){
-  std::ofstream file("Search/Magic/magics.txt",std::ofstream::out | std::ofstream::trunc);
+//written to a temporary file and renamed over magics.txt, so an interrupted save never leaves a partial file
+bool Search::saveMagics(){
+  std::ofstream file("Search/Magic/magics.txt.tmp",std::ofstream::out | std::ofstream::trunc);
   if(!file.is_open()){
-    std::cout<<"[error] Could not open magics.txt"<<std::endl;
-    return;
+    std::cout<<"[error] Could not open magics.txt.tmp"<<std::endl;
+    return false;
   }
   int i = 0;
   for(u64 u : rookMagics){
@@ -143,6 +211,13 @@ void Search::saveMagics(){
   for(u64 u : bishopMagics){
     file<<std::to_string(u)<<"\n"<<std::to_string(bishopShifts[i++])<<"\n";
   }
+  file.close();
+  if(file.fail() || std::rename("Search/Magic/magics.txt.tmp", "Search/Magic/magics.txt") != 0){
+    std::cout<<"[error] Could not write magics.txt"<<std::endl;
+    std::remove("Search/Magic/magics.txt.tmp");
+    return false;
+  }
+  return true;
 };
 
 void Search::loadMagics(){
@@ -0,0 +1,325 @@
+#include "../search.h"
+
+//depth-first proof-number search (df-pn, Nagai 2002) for forced mates
+//the attacker is the side trying to mate, every position is an OR node when it is to move and an AND node when the defender is
+//a node is searched until its phi or delta reaches the thresholds its parent gave it, then the parent picks the next most proving child
+//the plies left are part of the key, so a node is only ever reused with the same bound and the tree has no cycles
+
+void MateTable::resize(int megabytes){
+  u64 buckets = 1;
+  while(buckets*2*MATE_BUCKET*sizeof(MateEntry) <= (u64)megabytes*1024*1024) buckets *= 2;
+  entries.assign(buckets*MATE_BUCKET, MateEntry{});
+  mask = buckets-1;
+  used = 0;
+  replaced = 0;
+}
+
+void MateTable::clear(){
+  std::fill(entries.begin(), entries.end(), MateEntry{});
+  used = 0;
+  replaced = 0;
+}
+
+MateEntry const *MateTable::probe(u64 key) const{
+  MateEntry const *bucket = &entries[(key & mask)*MATE_BUCKET];
+  for(int i = 0; i<MATE_BUCKET; i++){
+    if(bucket[i].key == key) return &bucket[i];
+  }
+  return nullptr;
+}
+
+//a full bucket gives up its unsolved entry with the least work, solved entries go last
+void MateTable::store(u64 key, unsigned int phi, unsigned int delta, unsigned int work, Move move){
+  MateEntry *bucket = &entries[(key & mask)*MATE_BUCKET];
+  MateEntry *slot = nullptr;
+  for(int i = 0; i<MATE_BUCKET && !slot; i++){
+    if(bucket[i].key == key) slot = &bucket[i];
+  }
+  for(int i = 0; i<MATE_BUCKET && !slot; i++){
+    if(bucket[i].key == 0){
+      slot = &bucket[i];
+      used++;
+    }
+  }
+  if(!slot){
+    auto cost = [](MateEntry const &e){return (u64)e.work + ((e.phi == 0 || e.delta == 0) ? (u64)1<<32 : 0);};
+    slot = bucket;
+    for(int i = 1; i<MATE_BUCKET; i++){
+      if(cost(bucket[i]) < cost(*slot)) slot = &bucket[i];
+    }
+    replaced++;
+  }
+  *slot = {key, phi, delta, work, move};
+  //hashing is not even, buckets overflow long before the table fills up
+  if(used*100 >= entries.size()*MATE_GC_FILL || replaced*100 >= entries.size()*MATE_GC_REPLACED) collect();
+}
+
+//frees the half of the entries with the least work, by a histogram of log2(work)
+//the entries in the bucket the median falls in are freed only until half are gone
+void MateTable::collect(){
+  auto level = [](MateEntry const &e){return 64-__builtin_clzll((u64)e.work+1)-1;};
+  u64 histogram[33] = {};
+  for(MateEntry const &e : entries){
+    if(e.key) histogram[level(e)]++;
+  }
+  int cutoff = 0;
+  u64 below = 0;
+  while(cutoff < 32 && below + histogram[cutoff] < used/2) below += histogram[cutoff++];
+  u64 partial = used/2 - below;//from the cutoff level
+  for(MateEntry &e : entries){
+    if(!e.key || level(e) > cutoff) continue;
+    if(level(e) == cutoff){
+      if(partial == 0) continue;
+      partial--;
+    }
+    e = MateEntry{};
+    used--;
+    freed++;
+  }
+  replaced = 0;
+  collections++;
+}
+
+u64 Search::mateKey(Position const &board, int plies, bool attacking) const{
+  return board.hash() ^ ((u64)(plies+1)*0x9E3779B97F4A7C15ull) ^ (attacking ? 0xD6E8FEB86659FD93ull : 0);
+}
+
+bool Search::isMate(Board &board){
+  int own = (board.flags & WHITE_TO_MOVE_BIT) ? WHITE : BLACK;
+  if(!isAttacked(board, lsb(board.bitboard(own+KING)), own == WHITE ? BLACK : WHITE)) return false;
+  PlyMoves<Move> moves(moveArena);
+  generateMoves(board, moves);
+  return moves.size() == 0;
+}
+
+//MID of df-pn, phi and delta saturate at MATE_INFINITE-1 unless a child is solved
+void Search::mateSearch(Board &board, int plies, bool attacking, unsigned int phiLimit, unsigned int deltaLimit){
+  nodes++;
+  if(nodeLimit && nodes >= nodeLimit) stopped = true;
+  u64 key = mateKey(board, plies, attacking);
+  MateEntry const *entry = mateTable->probe(key);
+  unsigned int work = entry ? entry->work : 0;
+  u64 start = nodes;
+  //the defender out of plies has survived unless it is mated right now, an attack with isAttacked settles most of them
+  if(plies <= 0 && !attacking && !isMate(board)){
+    mateTable->store(key, 0, MATE_INFINITE, work+1, Move());
+    return;
+  }
+  PlyMoves<Move> moves(moveArena);
+  generateMoves(board, moves);
+  if(moves.size() == 0){
+    //mated loses for whoever is to move, stalemate is a win for the defender
+    bool defenderWins = !attacking && !inCheck(board);
+    mateTable->store(key, defenderWins ? 0 : MATE_INFINITE, defenderWins ? MATE_INFINITE : 0, work+1, Move());
+    return;
+  }
+  if(plies <= 0){
+    mateTable->store(key, MATE_INFINITE, 0, work+1, Move());//the attacker ran out of moves
+    return;
+  }
+  //with one ply left only a mate now counts, the replies are tried here rather than stored, they are most of the tree
+  if(plies == 1 && attacking){
+    for(int i = 0; i<moves.size(); i++){
+      board.makeMove(moves.begin[i]);
+      nodes++;
+      bool mate = isMate(board);
+      board.unmakeMove(moves.begin[i]);
+      if(mate){
+        mateTable->store(key, 0, MATE_INFINITE, work + (nodes-start) + 1, moves.begin[i]);
+        return;
+      }
+    }
+    mateTable->store(key, MATE_INFINITE, 0, work + (nodes-start) + 1, Move());
+    return;
+  }
+  u64 childKeys[256];
+  for(int i = 0; i<moves.size(); i++){
+    board.makeMove(moves.begin[i]);
+    childKeys[i] = mateKey(board, plies-1, !attacking);
+    board.unmakeMove(moves.begin[i]);
+  }
+  while(true){
+    //phi is the smallest delta of the children, delta the sum of their phis
+    unsigned int phi = MATE_INFINITE, delta = 0;
+    unsigned int bestDelta = MATE_INFINITE, secondDelta = MATE_INFINITE, bestPhi = 0;
+    int best = 0;
+    for(int i = 0; i<moves.size(); i++){
+      MateEntry const *child = mateTable->probe(childKeys[i]);
+      unsigned int childPhi = child ? child->phi : 1;
+      unsigned int childDelta = child ? child->delta : 1;
+      phi = std::min(phi, childDelta);
+      if(childPhi >= MATE_INFINITE || delta >= MATE_INFINITE) delta = MATE_INFINITE;
+      else delta = std::min(delta + childPhi, MATE_INFINITE-1);
+      if(childDelta < bestDelta){
+        secondDelta = bestDelta;
+        bestDelta = childDelta;
+        bestPhi = childPhi;
+        best = i;
+      }else if(childDelta < secondDelta){
+        secondDelta = childDelta;
+      }
+    }
+    if(phi >= phiLimit || delta >= deltaLimit || stopped){
+      mateTable->store(key, phi, delta, work + (nodes-start), moves.begin[best]);
+      return;
+    }
+    unsigned int childPhiLimit = deltaLimit - (delta - bestPhi);
+    unsigned int childDeltaLimit = std::min(phiLimit, secondDelta >= MATE_INFINITE ? MATE_INFINITE : secondDelta+1);
+    board.makeMove(moves.begin[best]);
+    mateSearch(board, plies-1, !attacking, childPhiLimit, childDeltaLimit);
+    board.unmakeMove(moves.begin[best]);
+  }
+}
+
+bool Search::proveMate(Board &board, int plies, bool attacking){
+  mateSearch(board, plies, attacking, MATE_INFINITE, MATE_INFINITE);
+  MateEntry const *root = mateTable->probe(mateKey(board, plies, attacking));
+  return root && (attacking ? root->phi == 0 : root->delta == 0);
+}
+
+//the attacker plays its winning move, the defender the reply with the most work below it (the hardest to prove)
+//a node the collections freed is proven again
+std::vector<Move> Search::mateLine(Board &board, int plies, bool attacking){
+  std::vector<Move> line;
+  while(plies >= 0 && !stopped){
+    PlyMoves<Move> moves(moveArena);
+    generateMoves(board, moves);
+    if(moves.size() == 0) break;
+    Move chosen;
+    u64 mostWork = 0;
+    for(int i = 0; i<moves.size(); i++){
+      board.makeMove(moves.begin[i]);
+      u64 key = mateKey(board, plies-1, !attacking);
+      if(!mateTable->probe(key)) proveMate(board, plies-1, !attacking);
+      MateEntry const *child = mateTable->probe(key);
+      board.unmakeMove(moves.begin[i]);
+      bool proven = child && (attacking ? child->delta == 0 : child->phi == 0);
+      if(!proven) continue;
+      if(attacking){
+        chosen = moves.begin[i];
+        break;
+      }
+      if(child->work+1 > mostWork){
+        mostWork = child->work+1;
+        chosen = moves.begin[i];
+      }
+    }
+    if(chosen.getMoveData() == 0) break;
+    line.push_back(chosen);
+    board.makeMove(chosen);
+    plies--;
+    attacking = !attacking;
+  }
+  for(size_t i = line.size(); i-->0;) board.unmakeMove(line[i]);
+  return line;
+}
+
+//mate in 1, 2, 3... for the side to move, and then being mated in as many moves, until one is proven
+MateResult Search::solveMate(Board &board, int maxMoves, u64 maxNodes){
+  if(!mateTable) mateTable = std::make_shared<MateTable>();
+  MateResult result;
+  auto start = std::chrono::steady_clock::now();
+  nodes = 0;
+  nodeLimit = maxNodes;
+  stopped = false;
+  for(int moves = 1; moves<=maxMoves && !stopped && !result.found; moves++){
+    for(bool winning : {true, false}){
+      int plies = winning ? 2*moves-1 : 2*moves;
+      if(!proveMate(board, plies, winning)) continue;
+      result.found = true;
+      result.winning = winning;
+      result.moves = moves;
+      result.line = mateLine(board, plies, winning);
+      break;
+    }
+  }
+  result.nodes = nodes;
+  result.ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-start).count();
+  nodeLimit = 0;
+  stopped = false;
+  return result;
+}
+
+//every position is solved by df-pn and by a plain alpha-beta (everything selective off) deepened until it returns the mate score
+//both start from empty tables, the mate lengths have to agree
+void Search::runMateBench(){
+  struct MatePosition{
+    char const *fen;
+    int moves;
+  };
+  MatePosition const positions[] = {
+    {"6k1/5ppp/8/8/8/8/8/R5K1 w - - 0 1", 1},
+    {"4k3/8/4K3/8/8/8/8/7R w - - 0 1", 1},
+    {"r1bqkb1r/pppp1ppp/2n2n2/4p2Q/2B1P3/8/PPPP1PPP/RNB1K1NR w KQkq - 4 4", 1},
+    {"kbK5/pp6/1P6/8/8/8/8/R7 w - - 0 1", 2},
+    {"2rr3k/pp3pp1/1nnqbN1p/3pN3/2pP4/2P3Q1/PPB4P/R4RK1 w - - 0 1", 2},
+    {"r1bq2rk/pp3pbp/2p1p1pQ/7P/3P4/2PB1N2/PP3PPR/2KR4 w - - 0 1", 2},
+    {"5k2/6pp/p1qN4/1p1p4/3P4/2PKP2Q/PP3r2/3R4 b - - 0 1", 2},
+    {"6k1/pp4p1/2p5/2bp4/8/P5Pb/1P3rrP/2BRRN1K b - - 0 1", 2},
+    {"r2qkb1r/pp2nppp/3p4/2pNN1B1/2BnP3/3P4/PPP2PPP/R2bK2R w KQkq - 1 1", 2},
+    {"r5rk/5p1p/5R2/4B3/8/8/7P/7K w - - 0 1", 3},
+    {"8/8/8/8/8/4k3/8/3QK3 w - - 0 1", 5},
+  };
+  if(!tt) tt = std::make_shared<TranspositionTable>();
+  if(!mateTable) mateTable = std::make_shared<MateTable>();
+  SearchFeatures saved = features;
+  std::shared_ptr<const OpeningBook> savedBook = book;
+  std::shared_ptr<const Bitbases> savedBitbases = bitbases;
+  std::shared_ptr<PositionCache> savedCache = positionCache;
+  book = nullptr;
+  bitbases = nullptr;
+  positionCache = nullptr;
+  Board board;
+  u64 totalNodes[2] = {}, totalNs[2] = {};
+  int solved[2] = {};
+  for(MatePosition const &position : positions){
+    board.loadFromFEN(position.fen);
+    bool whiteToMove = board.flags & WHITE_TO_MOVE_BIT;
+    mateTable->clear();
+    MateResult mate = solveMate(board, position.moves);
+    bool mateOk = mate.found && mate.winning && mate.moves == position.moves;
+    solved[0] += mateOk;
+    totalNodes[0] += mate.nodes;
+    totalNs[0] += mate.ns;
+
+    for(char const *name : {"pvs", "nmp", "lmr", "rfp", "futility", "razoring", "checkext"}) features.set(name, false);
+    tt->clear();
+    auto start = std::chrono::steady_clock::now();
+    u64 searched = 0;
+    int score = 0;
+    for(int depth = 1; depth<=2*position.moves+1 && score < MATE_SCORE - MAX_SEARCH_PLY; depth++){
+      searchBestMove(board, depth, 0, score);
+      searched += nodes;
+    }
+    u64 ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-start).count();
+    features = saved;
+    int alphaBetaMoves = score >= MATE_SCORE - MAX_SEARCH_PLY ? (MATE_SCORE - score + 1)/2 : 0;
+    solved[1] += alphaBetaMoves == position.moves;
+    totalNodes[1] += searched;
+    totalNs[1] += ns;
+
+    std::cout<<"mate in "<<position.moves<<": df-pn "<<(mateOk ? "solved" : "FAILED")<<" "<<mate.nodes<<" nodes "<<(float)mate.ns/1e6f<<"ms";
+    std::cout<<", alpha-beta "<<(alphaBetaMoves == position.moves ? "solved" : "FAILED")<<" "<<searched<<" nodes "<<(float)ns/1e6f<<"ms";
+    std::cout<<", line "<<debug::lineToUci(mate.line, whiteToMove)<<"\n";
+  }
+  int count = sizeof(positions)/sizeof(positions[0]);
+  char const *names[2] = {"df-pn     ", "alpha-beta"};
+  for(int i = 0; i<2; i++){
+    std::cout<<names[i]<<": "<<solved[i]<<"/"<<count<<" solved, "<<totalNodes[i]<<" nodes, "<<(float)totalNs[i]/1e9f<<"s, ";
+    std::cout<<(u64)(totalNodes[i]*1e9/(totalNs[i] ? totalNs[i] : 1))<<" nodes/s"<<std::endl;
+  }
+  //a proof that does not fit its table, solved once with the normal table and once with one small enough to need collections
+  board.loadFromFEN("8/8/8/4k3/8/8/8/3QK3 w - - 0 1");
+  std::shared_ptr<MateTable> savedTable = mateTable;
+  for(int megabytes : {16, 2}){
+    mateTable = std::make_shared<MateTable>(megabytes);
+    MateResult mate = solveMate(board, 7);
+    bool mateOk = mate.found && mate.winning && mate.moves == 7;
+    std::cout<<"mate in 7, "<<mateTable->size()/1024<<" KB table: "<<(mateOk ? "solved" : "FAILED")<<" "<<mate.nodes<<" nodes ";
+    std::cout<<(float)mate.ns/1e6f<<"ms, "<<mateTable->collections<<" collections freed "<<mateTable->freed<<" entries"<<std::endl;
+  }
+  mateTable = savedTable;
+  book = savedBook;
+  bitbases = savedBitbases;
+  positionCache = savedCache;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <vector>
+
+#include "../../Board/board.h"
+
+#define MATE_INFINITE 100000000u//proof and disproof numbers saturate below this, reaching it means solved
+#define MATE_BUCKET 4
+#define MATE_GC_FILL 90//percent of the table in use before a collection
+#define MATE_GC_REPLACED 25//or percent of the table overwritten in full buckets since the last one
+
+//one node of the proof tree, phi and delta are from the side to move's point of view:
+//phi is the proof number when the attacker is to move and the disproof number when the defender is
+//phi = 0 means the side to move reaches its goal, delta = 0 means it cannot
+struct MateEntry{
+  u64 key;//position hash mixed with the plies left and whose turn it is
+  unsigned int phi;
+  unsigned int delta;
+  unsigned int work;//nodes searched below it, collections free the entries with the least work
+  Move move;//the child it last searched, a winning move once phi is 0
+};
+static_assert(sizeof(MateEntry) == 24, "MateEntry should stay 24 bytes");
+
+//node store of the df-pn solver, buckets of MATE_BUCKET entries
+//when MATE_GC_FILL percent of it is used, or full buckets have overwritten MATE_GC_REPLACED percent of it,
+//the half of the entries with the least work below them is freed,
+//so memory stays bounded however long a proof takes and the expensive subtrees survive
+class MateTable{
+  std::vector<MateEntry> entries;
+  u64 mask = 0;//buckets - 1
+  u64 used = 0;
+  u64 replaced = 0;//entries of other nodes overwritten since the last collection
+  void collect();
+public:
+  MateTable(int megabytes = 16){resize(megabytes);}
+  void resize(int megabytes);//rounded down to a power of two buckets
+  void clear();
+  MateEntry const *probe(u64 key) const;//nullptr when the node is not stored
+  void store(u64 key, unsigned int phi, unsigned int delta, unsigned int work, Move move);
+  u64 collections = 0;
+  u64 freed = 0;//entries freed by collections
+  u64 size() const {return entries.size()*sizeof(MateEntry);}//in bytes
+  int fill() const {return used*1000/entries.size();}//permille
+};
+
+struct MateResult{
+  bool found = false;
+  bool winning = false;//the side to move gives the mate, otherwise it is mated
+  int moves = 0;//mate in this many moves of the winning side
+  std::vector<Move> line;//from the position searched, ends in mate
+  u64 nodes = 0;
+  u64 ns = 0;
+};
@@ -0,0 +1,79 @@
+#include "largepages.h"
+#include <algorithm>
+#include <fstream>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/mman.h>
+
+bool useHugePages = true;
+
+char const *pageBackingName(PageBacking backing){
+  switch(backing){
+    case PAGES_EXPLICIT: return "explicit huge pages";
+    case PAGES_TRANSPARENT: return "transparent huge pages";
+    default: return "normal pages";
+  }
+}
+
+namespace{
+//"never" is selected when the kernel will not use transparent huge pages even after madvise
+bool transparentHugePagesAvailable(){
+  std::ifstream in("/sys/kernel/mm/transparent_hugepage/enabled");
+  std::string setting;
+  return std::getline(in, setting) && setting.find("[never]") == std::string::npos;
+}
+
+//one write per normal page, each thread takes a contiguous slice
+void prefault(char *data, u64 length, int threads){
+  if(threads <= 0) threads = std::thread::hardware_concurrency();
+  u64 chunks = length/HUGE_PAGE_SIZE;
+  if((u64)threads > chunks) threads = chunks ? chunks : 1;
+  auto touch = [data](u64 begin, u64 end){
+    for(u64 i = begin; i<end; i += 4096) *(volatile char *)(data+i) = 0;
+  };
+  if(threads == 1){
+    touch(0, length);
+    return;
+  }
+  std::vector<std::thread> workers;
+  u64 slice = (chunks + threads - 1)/threads*HUGE_PAGE_SIZE;
+  for(int t = 0; t<threads; t++){
+    u64 begin = t*slice;
+    u64 end = std::min(length, begin+slice);
+    if(begin < end) workers.emplace_back(touch, begin, end);
+  }
+  for(std::thread &w : workers) w.join();
+}
+}
+
+std::shared_ptr<void> allocateLarge(u64 bytes, PageBacking &backing, int threads){
+  u64 length = (bytes + HUGE_PAGE_SIZE - 1)/HUGE_PAGE_SIZE*HUGE_PAGE_SIZE;
+  if(length == 0) length = HUGE_PAGE_SIZE;
+  char *data = nullptr;
+  backing = PAGES_NORMAL;
+#ifdef MAP_HUGETLB
+  if(useHugePages){
+    void *mapped = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if(mapped != MAP_FAILED){
+      data = (char *)mapped;
+      backing = PAGES_EXPLICIT;
+    }
+  }
+#endif
+  if(!data){
+    //over allocate so the block can start on a huge page boundary, then give back the ends
+    void *mapped = mmap(nullptr, length + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(mapped == MAP_FAILED) throw std::bad_alloc();
+    char *base = (char *)mapped;
+    data = (char *)(((u64)base + HUGE_PAGE_SIZE - 1) & ~(u64)(HUGE_PAGE_SIZE - 1));
+    if(data > base) munmap(base, data-base);
+    if(data+length < base+length+HUGE_PAGE_SIZE) munmap(data+length, base+length+HUGE_PAGE_SIZE - (data+length));
+#ifdef MADV_HUGEPAGE
+    if(useHugePages && transparentHugePagesAvailable() && madvise(data, length, MADV_HUGEPAGE) == 0) backing = PAGES_TRANSPARENT;
+#endif
+  }
+  prefault(data, length, threads);
+  return std::shared_ptr<void>(data, [length](void *p){ munmap(p, length); });
+}
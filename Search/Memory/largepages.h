@@ -0,0 +1,21 @@
+#pragma once
+#include <memory>
+
+#include "../../Board/Bitboards/bitboard.h"
+
+#define HUGE_PAGE_SIZE (2*1024*1024)
+
+enum PageBacking{
+  PAGES_NORMAL,
+  PAGES_TRANSPARENT,//madvise(MADV_HUGEPAGE), the kernel backs what it can with huge pages
+  PAGES_EXPLICIT//MAP_HUGETLB, from the reserved pool (vm.nr_hugepages)
+};
+
+extern bool useHugePages;//cleared by --no-huge-pages, only affects later allocations
+char const *pageBackingName(PageBacking backing);
+
+//Zeroed memory for the engine's big tables (slider attacks, hash tables), aligned to HUGE_PAGE_SIZE
+//Tries explicit huge pages, then transparent huge pages, then normal pages, backing says which one it got
+//Every page is touched before it returns, split over threads = 0 (every core) so the first search does not take the page faults
+//The memory is unmapped when the last owner is gone
+std::shared_ptr<void> allocateLarge(u64 bytes, PageBacking &backing, int threads = 0);
@@ -1,117 +1,92 @@
 #include "search.h"
-Search::Search() {
-  loadMagics();
+Search::Search(std::string attackCache) : attackCachePath(attackCache) {
   generateFileMasks();
   generateRankMasks();
   generateKnightMoves();
+  generateKingMoves();
+  generatePawnCaptures();
+  if(attackCachePath != "" && loadAttackCache()) return;
+  loadMagics();
   generateRookMasks();
   generateBishopMasks();
-  generateKingMoves();
-  fillRookMoves();
-  fillBishopMoves();
-
+  fillSliderMoves();
+  if(attackCachePath != "") saveAttackCache();
 }
-void Search::generateMoves(Board &board, MoveList &moves) {
-  if(!(board.flags&THREATENED_POPULATED)){
-    board.flags |= THREATENED_POPULATED;
-    generateMoves(board, moves);
-    board.flags ^= WHITE_TO_MOVE_BIT;
-    generateMoves(board, moves);
-    board.flags ^= WHITE_TO_MOVE_BIT;
-  }
+Move *Search::generateMoves(Position const &board, AttackInfo const &info, Move *moves) {
   friendlyBitboard = (board.flags & WHITE_TO_MOVE_BIT)
-     ? board.bitboards[WHITE_PIECES]
-     : board.bitboards[BLACK_PIECES];
+     ? board.colorBitboards[0]
+     : board.colorBitboards[1];
   enemyBitboard = (board.flags & WHITE_TO_MOVE_BIT)
-     ? board.bitboards[BLACK_PIECES]
-     : board.bitboards[WHITE_PIECES];
+     ? board.colorBitboards[1]
+     : board.colorBitboards[0];
 
   color = (board.flags & WHITE_TO_MOVE_BIT) ? WHITE : BLACK;
-  threatenedIndex = (board.flags & WHITE_TO_MOVE_BIT) ? 0 : 1;
-  board.threatened[threatenedIndex] = (u64)0;
-  moves.end = 0;
-  addPawnMoves(board, moves);
-  addSlidingMoves(board, moves);
-  addKnightMoves(board, moves);
-  addKingMoves(board, moves);
-  addCastlingMoves(board, moves);
-  if(!inFilter){
-    filterLegalMoves(board, moves);
-  }
+  cursor = moves;
+  addPawnMoves(board);
+  addSlidingMoves(board);
+  addKnightMoves(board);
+  addKingMoves(board);
+  addCastlingMoves(board, info);
+  return filterLegalMoves(board, info, moves, cursor);
+}
+
+void Search::generateMoves(Position const &board, MoveList &moves){
+  moves.end = generateMoves(board, moves.moves) - moves.moves;
 }
 
-void Search::filterLegalMoves(Board board, MoveList &moves){
-  inFilter = true;
+void Search::generateMoves(Position const &board, PlyMoves<Move> &moves){
+  moves.end = generateMoves(board, moves.begin);
+  moves.claim();
+}
+
+//king moves are checked against the attack map, other moves are legal unless the piece is pinned,
+//the king is in check or it is en passan, those are played on a copy of the position and tested
+//illegal moves are replaced by the last move, returns the new end
+Move *Search::filterLegalMoves(Position const &board, AttackInfo const &info, Move *begin, Move *end){
   byte friendlyColor = color;
   byte opponentColor = (color == WHITE)? BLACK : WHITE;
-  for(int i = moves.end-1; i>=0; i--){
-    board.makeMove(moves.moves[i]);
-    byte kingSquare = bitScanForward(board.bitboards[friendlyColor+KING]);
-    bool isLegal = !isAttacked(board, kingSquare, opponentColor);
-    board.unmakeMove(moves.moves[i]);
-    moves.moves[i].resetUnmakeData();
+  int king = lsb(board.bitboard(friendlyColor+KING));
+  for(Move *m = end; m-- != begin;){
+    bool isLegal;
+    if(m->isKingside() || m->isQueenside()){
+      isLegal = true;//checked by addCastlingMoves
+    }else if(m->getFrom() == king){
+      isLegal = !getBit(info.attacked, m->getTo());
+    }else if(!info.checkers && !getBit(info.pinned, m->getFrom()) && !m->isEnPassan()){
+      isLegal = true;
+    }else{
+      Position next = board;
+      next.applyMove(*m);
+      isLegal = !isAttacked(next, king, opponentColor);
+    }
     if(!isLegal){
-       moves.remove(i);
+      *m = *--end;
     }
   }
-  inFilter = false;
+  return end;
 }
 
-bool Search::isAttacked(Board const &board, byte square, byte opponentColor){
-  //attacked by knight
-  u64 possibleKnights = knightMoves[square];
-  if(possibleKnights&board.bitboards[KNIGHT+opponentColor]) return true;
-  
-  //attacked by king
-  u64 possibleKings = kingMoves[square];
-  if(possibleKings & board.bitboards[KING+opponentColor]) return true;
-  //attacked by sliders
-  u64 blockers = board.occupancy & rookMasks[square];
-  u64 hashed = (blockers * rookMagics[square]) >> rookShifts[square];
-  u64 possibleRooks = rookMoves[square][hashed];
-  if(possibleRooks&board.bitboards[ROOK+opponentColor]) return true;
-
-  blockers = board.occupancy & bishopMasks[square];
-  hashed = (blockers * bishopMagics[square]) >> bishopShifts[square];
-  u64 possibleBishops = bishopMoves[square][hashed];
-  if(possibleBishops&board.bitboards[BISHOP+opponentColor]) return true;
-
-  if((possibleBishops|possibleRooks)&board.bitboards[QUEEN+opponentColor]) return true;
-  
-  //attacked by pawn
-  u64 possiblePawns = u64(0);
-  if(opponentColor == WHITE){
-    if(square%8 != 0)setBit(possiblePawns, square-9);
-    if(square%8 != 7)setBit(possiblePawns, square-7);
-  }else{
-    if(square%8 != 7)setBit(possiblePawns, square+9);
-    if(square%8 != 0)setBit(possiblePawns, square+7);
-  }
-  if(possiblePawns & board.bitboards[PAWN + opponentColor]) return true;
-  
-  return false;
-}
-void Search::addSlidingMoves(Board &board, MoveList &moves) {
-  u64 horizontalPieces = board.bitboards[color + ROOK] | board.bitboards[color + QUEEN];
-  u64 diagonalPieces = board.bitboards[color + BISHOP] | board.bitboards[color + QUEEN];
+void Search::addSlidingMoves(Position const &board) {
+  u64 horizontalPieces = board.bitboard(color + ROOK) | board.bitboard(color + QUEEN);
+  u64 diagonalPieces = board.bitboard(color + BISHOP) | board.bitboard(color + QUEEN);
   while (horizontalPieces) {
-    addHorizontalMoves(board, popls1b(horizontalPieces), moves);
+    addHorizontalMoves(board, popLsb(horizontalPieces));
   }
   while (diagonalPieces) {
-    addDiagonalMoves(board, popls1b(diagonalPieces), moves);
+    addDiagonalMoves(board, popLsb(diagonalPieces));
   }
 }
 
-void Search::addMovesFromOffset(MoveList &moves, int offset, u64 targets, byte flags){
+void Search::addMovesFromOffset(int offset, u64 targets, byte flags){
   while (targets) {
-    byte to = popls1b(targets);
+    byte to = popLsb(targets);
     if(to<8 || to>55){ 
       for(int i = BISHOP; i<= QUEEN;i++){
         Move move;
         move.setTo(to);
         move.setFrom(to + offset);
         move.setPromotion(i);
-        moves.append(move);
+        *cursor++ = move;
       }
       continue;
     }
@@ -119,97 +94,87 @@ void Search::addMovesFromOffset(MoveList &moves, int offset, u64 targets, byte f
     move.setTo(to);
     move.setFrom(to + offset);
     move.setSpecialMoveData(flags);
-    moves.append(move);
+    *cursor++ = move;
   }
 }
 
-void Search::addPawnMoves(Board &board, MoveList &moves) {
-  int dir = board.flags & WHITE_TO_MOVE_BIT ? 1 : -1;
-  u64 leftFileMask = (board.flags & WHITE_TO_MOVE_BIT) ? fileMasks[7] : fileMasks[0];
-  u64 rightFileMask = (board.flags & WHITE_TO_MOVE_BIT) ? fileMasks[0] : fileMasks[7];
-  u64 startRank = (board.flags & WHITE_TO_MOVE_BIT ? rankMasks[1] : rankMasks[6]);
+void Search::addPawnMoves(Position const &board) {
+  if(board.flags & WHITE_TO_MOVE_BIT) addPawnMoves<1>(board);
+  else addPawnMoves<-1>(board);
+}
+
+//dir is 1 for white and -1 for black, so every shift is known at compile time
+template<int dir>
+void Search::addPawnMoves(Position const &board) {
+  u64 leftFileMask = dir == 1 ? fileMasks[7] : fileMasks[0];
+  u64 rightFileMask = dir == 1 ? fileMasks[0] : fileMasks[7];
+  u64 startRank = dir == 1 ? rankMasks[1] : rankMasks[6];
+  u64 pawns = board.bitboard(color + PAWN);
+  u64 empty = ~board.occupancy();
   // forward pawn moves
-  u64 pawnDestinations = signedShift(board.bitboards[color + PAWN], 8 * dir);
-  pawnDestinations &= ~board.occupancy;
-  addMovesFromOffset(moves, -8*dir, pawnDestinations);
+  u64 pawnDestinations = shift<8*dir>(pawns) & empty;
+  addMovesFromOffset(-8*dir, pawnDestinations);
   
   // double forward moves
-  pawnDestinations = board.bitboards[color + PAWN] & startRank;
-  pawnDestinations = signedShift(pawnDestinations, 8 * dir);
-  pawnDestinations &=  ~board.occupancy;
-  pawnDestinations = signedShift(pawnDestinations, 8 * dir);
-  pawnDestinations &=  ~board.occupancy;
-  addMovesFromOffset(moves, -16*dir, pawnDestinations);
+  pawnDestinations = shift<8*dir>(pawns & startRank) & empty;
+  pawnDestinations = shift<8*dir>(pawnDestinations) & empty;
+  addMovesFromOffset(-16*dir, pawnDestinations);
 
   // pawn captures
-  pawnDestinations = signedShift(board.bitboards[color + PAWN], 7 * dir);
-  pawnDestinations &= ~leftFileMask & enemyBitboard;
-  board.threatened[threatenedIndex] |= pawnDestinations;
-  addMovesFromOffset(moves, -7*dir, pawnDestinations);
+  pawnDestinations = shift<7*dir>(pawns) & ~leftFileMask & enemyBitboard;
+  addMovesFromOffset(-7*dir, pawnDestinations);
 
-  pawnDestinations = signedShift(board.bitboards[color + PAWN], 9 * dir);
-  pawnDestinations &= ~rightFileMask & enemyBitboard;
-  board.threatened[threatenedIndex] |= pawnDestinations;
-  addMovesFromOffset(moves, -9*dir, pawnDestinations);
+  pawnDestinations = shift<9*dir>(pawns) & ~rightFileMask & enemyBitboard;
+  addMovesFromOffset(-9*dir, pawnDestinations);
 
   //En Passan
   if(board.enPassanTarget != EN_PASSAN_NULL){
-    pawnDestinations = signedShift(board.bitboards[color + PAWN], 7 * dir);
-    pawnDestinations &= ~leftFileMask;
-    pawnDestinations &= (u64)1<<board.enPassanTarget;
-    addMovesFromOffset(moves, -7*dir, pawnDestinations, EN_PASSAN);
-
-    pawnDestinations = signedShift(board.bitboards[color + PAWN], 9 * dir);
-    pawnDestinations &= ~rightFileMask;
-    pawnDestinations &= (u64)1<<board.enPassanTarget;
-    addMovesFromOffset(moves, -9*dir, pawnDestinations,EN_PASSAN);
+    u64 target = (u64)1<<board.enPassanTarget;
+    addMovesFromOffset(-7*dir, shift<7*dir>(pawns) & ~leftFileMask & target, EN_PASSAN);
+    addMovesFromOffset(-9*dir, shift<9*dir>(pawns) & ~rightFileMask & target, EN_PASSAN);
   }
 }
 
-void Search::addMovesToSquares(MoveList &moves, int fromSquare, u64 squares){
+void Search::addMovesToSquares(int fromSquare, u64 squares){
   while (squares) {
     Move move;
-    move.setTo(popls1b(squares));
+    move.setTo(popLsb(squares));
     move.setFrom(fromSquare);
-    moves.append(move);
+    *cursor++ = move;
   }
 }
-void Search::addHorizontalMoves(Board &board, int square, MoveList &moves) {
-  u64 blockers = board.occupancy & rookMasks[square];
+void Search::addHorizontalMoves(Position const &board, int square) {
+  u64 blockers = board.occupancy() & rookMasks[square];
   u64 hashed = (blockers * rookMagics[square]) >> rookShifts[square];
   u64 destinations = rookMoves[square][hashed] & (~friendlyBitboard);
-  board.threatened[threatenedIndex] |= destinations;
-  addMovesToSquares(moves, square, destinations);
+  addMovesToSquares(square, destinations);
 };
 
-void Search::addDiagonalMoves(Board &board, int square, MoveList &moves) {
-  u64 blockers = board.occupancy & bishopMasks[square];
+void Search::addDiagonalMoves(Position const &board, int square) {
+  u64 blockers = board.occupancy() & bishopMasks[square];
   u64 hashed = (blockers * bishopMagics[square]) >> bishopShifts[square];
   u64 destinations = bishopMoves[square][hashed] & (~friendlyBitboard);
-  board.threatened[threatenedIndex] |= destinations;
-  addMovesToSquares(moves, square, destinations);
+  addMovesToSquares(square, destinations);
 };
 
-void Search::addKnightMoves(Board &board, MoveList &moves) {
-  u64 friendlyKnights = board.bitboards[color + KNIGHT];
+void Search::addKnightMoves(Position const &board) {
+  u64 friendlyKnights = board.bitboard(color + KNIGHT);
   while (friendlyKnights) {
-    int square = popls1b(friendlyKnights);
+    int square = popLsb(friendlyKnights);
     u64 targets = knightMoves[square] & (~friendlyBitboard);
-    board.threatened[threatenedIndex] |= targets;
-    addMovesToSquares(moves, square, targets);
+    addMovesToSquares(square, targets);
   }
 }
 
-void Search::addKingMoves(Board &board, MoveList &moves) {
-  int square = bitScanForward(board.bitboards[color + KING]);
+void Search::addKingMoves(Position const &board) {
+  int square = lsb(board.bitboard(color + KING));
   u64 targets = kingMoves[square] & (~friendlyBitboard);
-  board.threatened[threatenedIndex] |= targets;
-  addMovesToSquares(moves, square, targets);
+  addMovesToSquares(square, targets);
 }
 
-void Search::addCastlingMoves(Board &board, MoveList &moves){
-  byte opponentColor = (color == WHITE)? BLACK : WHITE;
-  if(isAttacked(board,(byte)bitScanForward(board.bitboards[color+KING]),opponentColor)) return;//cannot castle out of check
+void Search::addCastlingMoves(Position const &board, AttackInfo const &info){
+  if(!(board.flags & (WHITE_CASTLING_RIGHTS | BLACK_CASTLING_RIGHTS))) return;
+  if(info.checkers) return;//cannot castle out of check
   int mustBeEmpty[4][3] = {{2,2,1},{4,5,6},{57,58,58},{62,61,60}};
   int mustBeSafe [4][2] = {{2,1},{4,5},{57,58},{61,60}};
   byte masks[4] = {WHITE_KINGSIDE_BIT,WHITE_QUEENSIDE_BIT,BLACK_KINGSIDE_BIT,BLACK_QUEENSIDE_BIT};
@@ -218,14 +183,14 @@ void Search::addCastlingMoves(Board &board, MoveList &moves){
   for(int j = i; j<max; j++){
     bool legal = true; 
     for(int s : mustBeEmpty[j]){
-      if(board.squares[s] != EMPTY){
+      if(board.piece(s) != EMPTY){
         legal = false;
         break;
       }
     }
     if(!legal) continue;
     for(int s : mustBeSafe[j]){
-      if(isAttacked(board, s, opponentColor)){
+      if(getBit(info.attacked, s)){
         legal = false;
         break;
       }
@@ -238,7 +203,7 @@ void Search::addCastlingMoves(Board &board, MoveList &moves){
       }else{
         m.setSpecialMoveData(CASTLE_QUEENSIDE); 
       }
-      moves.append(m);
+      *cursor++ = m;
     }
   }
 
@@ -329,48 +294,68 @@ void Search::generateKingMoves() {
   }
 }
 
-void Search::fillRookMoves() {
-  generateRookBlockers();
-  for (int i = 0; i < 64; i++) {
-    for (u64 blocker : rookBlockers[i]) {
-      u64 moves = (u64)0;
-      int directions[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
-      for (int direction = 0; direction < 4; direction++) {
-        int x = i % 8;
-        int y = i / 8;
-        while ((x >= 0 && x < 8) && (y >= 0 && y < 8)) {
-          setBit(moves, (y * 8) + x);
-          if (getBit(blocker, (y * 8) + x))
-            break;
-          x += directions[direction][0];
-          y += directions[direction][1];
-        }
-      }
-      rookMoves[i].insert({(blocker * rookMagics[i]) >> rookShifts[i], moves});
+u64 Search::computeSlidingMoves(int square, u64 blocker, bool rook) {
+  int rookDirections[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+  int bishopDirections[4][2] = {{-1, -1}, {1, 1}, {1, -1}, {-1, 1}};
+  int (*directions)[2] = rook ? rookDirections : bishopDirections;
+  u64 moves = (u64)0;
+  for (int direction = 0; direction < 4; direction++) {
+    int x = square % 8;
+    int y = square / 8;
+    while ((x >= 0 && x < 8) && (y >= 0 && y < 8)) {
+      setBit(moves, (y * 8) + x);
+      if (getBit(blocker, (y * 8) + x))
+        break;
+      x += directions[direction][0];
+      y += directions[direction][1];
     }
   }
+  return moves;
 }
 
-void Search::fillBishopMoves() {
+//Both tables live in one block, each square gets as many entries as its highest key needs
+void Search::fillSliderMoves() {
+  generateRookBlockers();
   generateBishopBlockers();
+  u64 rookSizes[64];
+  u64 bishopSizes[64];
+  u64 total = 0;
   for (int i = 0; i < 64; i++) {
-    for (u64 blocker : bishopBlockers[i]) {
-      u64 moves = (u64)0;
-      int directions[4][2] = {{-1, -1}, {1, 1}, {1, -1}, {-1, 1}};
-      for (int direction = 0; direction < 4; direction++) {
-        int x = i % 8;
-        int y = i / 8;
-        while ((x >= 0 && x < 8) && (y >= 0 && y < 8)) {
-          setBit(moves, (y * 8) + x);
-          if (getBit(blocker, (y * 8) + x))
-            break;
-          x += directions[direction][0];
-          y += directions[direction][1];
-        }
-      }
-      bishopMoves[i].insert(
-          {(blocker * bishopMagics[i]) >> bishopShifts[i], moves});
-    }
+    rookSizes[i] = 0;
+    for (u64 blocker : rookBlockers[i])
+      rookSizes[i] = std::max(rookSizes[i], ((blocker * rookMagics[i]) >> rookShifts[i]) + 1);
+    bishopSizes[i] = 0;
+    for (u64 blocker : bishopBlockers[i])
+      bishopSizes[i] = std::max(bishopSizes[i], ((blocker * bishopMagics[i]) >> bishopShifts[i]) + 1);
+    total += rookSizes[i] + bishopSizes[i];
+  }
+  std::shared_ptr<void> memory = allocateLarge(total*sizeof(u64), sliderTableBacking);
+  u64 *table = (u64 *)memory.get();
+  sliderTable = std::shared_ptr<const u64>(memory, table);
+  sliderTableSize = total;
+  u64 offset = 0;
+  for (int i = 0; i < 64; i++) {
+    rookOffsets[i] = offset;
+    for (u64 blocker : rookBlockers[i])
+      table[offset + ((blocker * rookMagics[i]) >> rookShifts[i])] = computeSlidingMoves(i, blocker, true);
+    offset += rookSizes[i];
+    bishopOffsets[i] = offset;
+    for (u64 blocker : bishopBlockers[i])
+      table[offset + ((blocker * bishopMagics[i]) >> bishopShifts[i])] = computeSlidingMoves(i, blocker, false);
+    offset += bishopSizes[i];
+  }
+  setSliderPointers();
+  //blockers are only needed to build the table
+  for (int i = 0; i < 64; i++) {
+    std::vector<u64>().swap(rookBlockers[i]);
+    std::vector<u64>().swap(bishopBlockers[i]);
+  }
+}
+
+void Search::setSliderPointers() {
+  for (int i = 0; i < 64; i++) {
+    rookMoves[i] = sliderTable.get() + rookOffsets[i];
+    bishopMoves[i] = sliderTable.get() + bishopOffsets[i];
   }
 }
 
@@ -382,21 +367,47 @@ u64 Search::perftTest(Board &b, int depth, bool root){
     return 0;
   }*/
   if(depth <= 0){return 1;}
+  bool cached = positionCache && depth >= POSITION_CACHE_MIN_DEPTH && !root;//the divide needs every root move counted
+  if(cached){
+    PositionCache::Result result;
+    if(positionCache->probe(b.hash(), result) && result.perftDepth == depth) return result.perftNodes;
+  }
   u64 count = 0;
-  MoveList moves;
+  PlyMoves<Move> moves(moveArena);
   generateMoves(b, moves);
-  for(byte i = 0; i<moves.end;i++){
-    b.makeMove(moves.moves[i]);
+  for(Move *m = moves.begin; m != moves.end; m++){
+    b.makeMove(*m);
     u64 found = perftTest(b, depth-1,false);
-    b.unmakeMove(moves.moves[i]);
+    b.unmakeMove(*m);
     if(root){
-      std::cout<<debug::moveToStr(moves.moves[i])<<" : "<<found<<std::endl;
+      std::cout<<debug::moveToStr(*m)<<" : "<<found<<std::endl;
     }
     count += found;
   }
+  if(cached) positionCache->storePerft(b.hash(), depth, count);
+  return count;
+}
+
+//copy-make perft, each ply writes the child into the next slot of positions instead of unmaking
+u64 Search::perftCopyTest(Position *positions, int depth){
+  if(depth <= 0) return 1;
+  u64 count = 0;
+  PlyMoves<Move> moves(moveArena);
+  generateMoves(positions[0], moves);
+  for(Move *m = moves.begin; m != moves.end; m++){
+    positions[1] = positions[0];
+    positions[1].applyMove(*m);
+    count += perftCopyTest(positions+1, depth-1);
+  }
   return count;
 }
 
+u64 Search::perftCopyMake(Position const &position, int depth){
+  std::vector<Position> positions(depth+1);
+  positions[0] = position;
+  return perftCopyTest(positions.data(), depth);
+}
+
 void Search::runMoveGenerationTest(Board &board){
   //https://www.chessprogramming.org/Perft_Results
   debug::Settings settings;
@@ -462,4 +473,184 @@ void Search::runMoveGenerationSuite(){
   auto duration = end-start;
   std::cout<<"Searched "<< sum << " moves\n";
   std::cout<<"Finished in "<<(float)std::chrono::duration_cast<std::chrono::milliseconds>(duration).count()/1000.f<<"s"<<std::endl;
+}
+
+//fixed positions and depths, the total node count of runBench is a signature of the move generator
+//the same binary must always print the same signature
+const BenchPosition benchPositions[BENCH_POSITIONS] = {
+  {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 4},
+  {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 3},
+  {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 5},
+  {"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 3},
+  {"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 3},
+  {"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 3}
+};
+
+void Search::runBench(int depth){
+  Board board;
+  u64 signature = 0;
+  auto start = std::chrono::high_resolution_clock::now();
+  for(int i = 0; i<BENCH_POSITIONS; i++){
+    board.loadFromFEN(benchPositions[i].fen);
+    int d = depth > 0 ? depth : benchPositions[i].depth;
+    u64 found = perftTest(board, d, false);
+    signature += found;
+    std::cout<<"Position "<<i+1<<" Depth: "<<d<<" Nodes: "<<found<<std::endl;
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+  u64 ms = std::chrono::duration_cast<std::chrono::milliseconds>(end-start).count();
+  std::cout<<"===========================\n";
+  std::cout<<"Slider tables   : "<<pageBackingName(sliderTableBacking)<<"\n";
+  std::cout<<"Total time (ms) : "<<ms<<"\n";
+  std::cout<<"Nodes searched  : "<<signature<<"\n";
+  std::cout<<"Nodes/second    : "<<(signature*1000)/(ms ? ms : 1)<<std::endl;
+}
+
+//same positions as runBench, perft with make/unmake against copy-make
+void Search::runCopyMakeBench(){
+  Board board;
+  u64 makeNodes = 0, copyNodes = 0, makeNs = 0, copyNs = 0;
+  for(BenchPosition const &position : benchPositions){
+    board.loadFromFEN(position.fen);
+    auto start = std::chrono::high_resolution_clock::now();
+    makeNodes += perftTest(board, position.depth, false);
+    auto mid = std::chrono::high_resolution_clock::now();
+    copyNodes += perftCopyMake(board, position.depth);
+    auto end = std::chrono::high_resolution_clock::now();
+    makeNs += std::chrono::duration_cast<std::chrono::nanoseconds>(mid-start).count();
+    copyNs += std::chrono::duration_cast<std::chrono::nanoseconds>(end-mid).count();
+  }
+  std::cout<<"Position "<<sizeof(Position)<<" bytes, Board "<<sizeof(Board)<<" bytes\n";
+  std::cout<<"Make/unmake : "<<makeNodes<<" nodes, "<<makeNodes*1000000000/(makeNs ? makeNs : 1)<<" nodes/s\n";
+  std::cout<<"Copy-make   : "<<copyNodes<<" nodes, "<<copyNodes*1000000000/(copyNs ? copyNs : 1)<<" nodes/s\n";
+  if(makeNodes != copyNodes) std::cout<<"\x1b[31m[error] node counts differ\x1b[0m\n";
+  std::cout<<std::flush;
+}
+
+//the bench perfts and fixed depth searches with a large hash table, on normal pages and then with huge pages
+//each run builds its own slider tables and hash table so both are allocated with the backing being measured
+void Search::runPageBench(int hashMegabytes){
+  bool hugePages = useHugePages;
+  for(bool huge : {false, true}){
+    useHugePages = huge;
+    auto start = std::chrono::high_resolution_clock::now();
+    auto local = std::make_unique<Search>();
+    local->tt = std::make_shared<TranspositionTable>(hashMegabytes);
+    auto ready = std::chrono::high_resolution_clock::now();
+    Board board;
+    u64 perftNodes = 0, perftNs = 0, searchNodes = 0, searchNs = 0;
+    for(BenchPosition const &position : benchPositions){
+      board.loadFromFEN(position.fen);
+      auto perftStart = std::chrono::high_resolution_clock::now();
+      perftNodes += local->perftTest(board, position.depth, false);
+      auto searchStart = std::chrono::high_resolution_clock::now();
+      int score;
+      local->findBestMove(board, 6, score);
+      auto end = std::chrono::high_resolution_clock::now();
+      searchNodes += local->nodes;
+      perftNs += std::chrono::duration_cast<std::chrono::nanoseconds>(searchStart-perftStart).count();
+      searchNs += std::chrono::duration_cast<std::chrono::nanoseconds>(end-searchStart).count();
+    }
+    u64 setupMs = std::chrono::duration_cast<std::chrono::milliseconds>(ready-start).count();
+    std::cout<<(huge ? "Huge pages" : "Normal pages")<<" (slider tables: "<<pageBackingName(local->sliderTableBacking);
+    std::cout<<", hash "<<hashMegabytes<<" MB: "<<pageBackingName(local->tt->backing)<<", setup "<<setupMs<<" ms)\n";
+    std::cout<<"  perft  : "<<perftNodes<<" nodes, "<<perftNodes*1000000000/(perftNs ? perftNs : 1)<<" nodes/s\n";
+    std::cout<<"  search : "<<searchNodes<<" nodes, "<<searchNodes*1000000000/(searchNs ? searchNs : 1)<<" nodes/s"<<std::endl;
+  }
+  useHugePages = hugePages;
+}
+
+void Search::runFENBench(){
+  std::string positions[6] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3"
+  };
+  const int iterations = 200000;
+  Board board;
+  char buffer[FEN_BUFFER_SIZE];
+  u64 checksum = 0;
+  auto start = std::chrono::high_resolution_clock::now();
+  for(int i = 0; i<iterations; i++){
+    checksum += board.loadFromFEN(positions[i%6]);
+    checksum += board.occupancy();
+  }
+  auto mid = std::chrono::high_resolution_clock::now();
+  for(int i = 0; i<iterations; i++){
+    board.loadFromFEN(positions[i%6]);
+    checksum += board.toFEN(buffer);
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+  u64 parseNs = std::chrono::duration_cast<std::chrono::nanoseconds>(mid-start).count();
+  u64 bothNs = std::chrono::duration_cast<std::chrono::nanoseconds>(end-mid).count();
+  u64 writeNs = bothNs > parseNs ? bothNs-parseNs : 1;
+  for(int i = 0; i<6; i++){
+    board.loadFromFEN(positions[i]);
+    board.toFEN(buffer);
+    if(positions[i] != buffer) std::cout<<"\x1b[31m[error] "<<positions[i]<<" came back as "<<buffer<<"\x1b[0m\n";
+  }
+  std::cout<<"Parse : "<<(u64)iterations*1000000000/(parseNs ? parseNs : 1)<<" positions/s\n";
+  std::cout<<"toFEN : "<<(u64)iterations*1000000000/writeNs<<" positions/s\n";
+  std::cout<<"(checksum "<<checksum<<")"<<std::endl;
+}
+
+//positions come from deterministic random playouts so the set has varied material
+//every position of random games from the start position, for the benches
+std::vector<Position> Search::randomGamePositions(int count){
+  std::vector<Position> positions;
+  positions.reserve(count);
+  Board board;
+  u64 seed = 1;
+  while((int)positions.size() < count){
+    board.loadFromFEN("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+    for(int ply = 0; ply<120 && (int)positions.size() < count; ply++){
+      MoveList moves;
+      generateMoves(board, moves);
+      if(moves.end == 0) break;
+      seed = seed*6364136223846793005ull + 1442695040888963407ull;
+      Move m = moves.moves[(seed>>33)%moves.end];
+      board.makeMove(m);
+      positions.push_back(board);
+    }
+  }
+  return positions;
+}
+
+void Search::runPackedBench(){
+  const int count = 100000;
+  std::vector<Position> boards = randomGamePositions(count);
+  std::vector<PackedBoard> packed(count);
+  std::vector<Position> decoded(count);
+  const int rounds = 20;
+  auto start = std::chrono::high_resolution_clock::now();
+  for(int r = 0; r<rounds; r++){
+    for(int i = 0; i<count; i++) packed[i].encode(boards[i]);
+  }
+  auto mid = std::chrono::high_resolution_clock::now();
+  for(int r = 0; r<rounds; r++){
+    for(int i = 0; i<count; i++) packed[i].decode(decoded[i]);
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+  int mismatches = 0;
+  char a[FEN_BUFFER_SIZE];
+  char b[FEN_BUFFER_SIZE];
+  for(int i = 0; i<count; i++){
+    boards[i].toFEN(a);
+    if(!packed[i].decode(decoded[i])){
+      mismatches++;
+      continue;
+    }
+    decoded[i].toFEN(b);
+    if(std::string(a) != b || !decoded[i].validate()) mismatches++;
+  }
+  u64 encodeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(mid-start).count();
+  u64 decodeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(end-mid).count();
+  std::cout<<"Position "<<sizeof(Position)<<" bytes, PackedBoard "<<sizeof(PackedBoard)<<" bytes\n";
+  std::cout<<"Encode : "<<(u64)count*rounds*1000000000/(encodeNs ? encodeNs : 1)<<" positions/s\n";
+  std::cout<<"Decode : "<<(u64)count*rounds*1000000000/(decodeNs ? decodeNs : 1)<<" positions/s\n";
+  if(mismatches) std::cout<<"\x1b[31m[error] "<<mismatches<<" positions did not round trip\x1b[0m\n";
+  std::cout<<std::flush;
 }
\ No newline at end of file
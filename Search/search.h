@@ -1,22 +1,99 @@
 #pragma once
 #include <chrono>
 #include <fstream>
-#include <map>//temporary 
+#include <memory>
 #include <vector>
 #include <cmath>
 #include <random>
+#include <thread>
+#include <atomic>
+#include <functional>
 #include "../Board/board.h"
+#include "../Board/Packed/packed.h"
 #include "../ui/debug.h"
+#include "Book/book.h"
+#include "Endgame/bitbase.h"
+#include "Hash/tt.h"
+#include "Hash/positioncache.h"
+#include "Memory/largepages.h"
+#include "Eval/evalcache.h"
+#include "Eval/weights.h"
+#include "Mate/mate.h"
 
+#define MATE_SCORE     30000
+#define INFINITE_SCORE 32000
+#define KNOWN_WIN      10000//bitbase wins, eval is added so the search still makes progress
+
+#define MAX_SEARCH_PLY  128
+#define HISTORY_MARGIN  64//plies of the board history left for captures below the last full width ply
+#define MAX_ROOT_PLY    (MAX_GAME_PLY - MAX_SEARCH_PLY - HISTORY_MARGIN)//games stop here, so a whole search still fits in the board history
+#define MAX_PERFT_DEPTH MAX_SEARCH_PLY//deeper perfts are rejected, perft has no ply limit of its own
+#define MAX_MATE_MOVES  (MAX_SEARCH_PLY/2)//longer mates are rejected, the proof tree is twice this many plies deep
+#define MOVE_ARENA_SIZE (MAX_SEARCH_PLY*256)
+
+//the fixed positions of the benches, depth is the perft depth that makes up the bench signature
+struct BenchPosition{
+  char const *fen;
+  int depth;
+};
+#define BENCH_POSITIONS 6
+extern const BenchPosition benchPositions[BENCH_POSITIONS];
+
+//one line of a multi-PV analysis, pv starts with the root move
+struct AnalysisLine{
+  int score;
+  std::vector<Move> pv;
+};
+
+//techniques of the selective search, all on by default, each one can be turned off to measure it (bench selective)
+//with everything off alphaBeta is a plain fail-soft alpha-beta
+struct SearchFeatures{
+  bool principalVariation = true;//pvs, zero window searches after the first move
+  bool nullMove = true;//nmp, verified at high depths
+  bool lateMoveReductions = true;//lmr
+  bool reverseFutility = true;//rfp
+  bool futility = true;//futility, skips quiet moves near the horizon
+  bool razoring = true;//razoring
+  bool checkExtensions = true;//checkext
+  bool set(std::string const &name, bool on);//by the short name above, false if there is no such feature
+};
+
+//fixed size list for callers outside the search
 struct MoveList{
   Move moves[255];//maximum number of legal moves possible in a position is 218, 255 is lust a beter number(and adds room for psedeo legal moves)
   byte end = 0;
   inline void append(Move const &m){moves[end] = m; end++;}
-  void remove(byte index){
-    for (byte i = index; i < end; i++)
-        moves[i] = moves[i + 1]; // copy next element left
-    end-=1;
-  }
+  inline void remove(byte index){moves[index] = moves[--end];}//swaps in the last move, order is not kept
+};
+
+//move packed with its ordering score, sorted as one 32 bit unit
+struct ScoredMove{
+  Move move;
+  short score;
+};
+static_assert(sizeof(Move) == 2 && sizeof(ScoredMove) == 4, "moves should stay packed");
+
+//one contiguous block shared by every ply of a search, plies take moves from the top like a stack
+template<typename T>
+struct MoveArena{
+  T entries[MOVE_ARENA_SIZE];
+  T *top = entries;
+  MoveArena(){}
+  MoveArena(MoveArena const &){}//a copy gets its own empty arena
+  MoveArena &operator=(MoveArena const &){top = entries; return *this;}
+};
+
+//the moves of one ply, [begin, end) in an arena, given back when it goes out of scope
+template<typename T>
+struct PlyMoves{
+  T *begin;
+  T *end;
+  MoveArena<T> &arena;
+  PlyMoves(MoveArena<T> &arena) : begin(arena.top), end(arena.top), arena(arena) {}
+  ~PlyMoves(){arena.top = begin;}
+  PlyMoves(PlyMoves const &) = delete;
+  inline int size() const {return end-begin;}
+  inline void claim(){arena.top = end;}//children allocate after this ply's moves
 };
 
 class Search{
@@ -24,27 +101,35 @@ class Search{
   u64 bishopMasks[64];
   u64 knightMoves[64];
   u64 kingMoves[64];
+  u64 pawnCaptures[2][64];//squares a pawn attacks, white first
   u64 rookMagics[64];
   int rookShifts[64];
   u64 bishopMagics[64];
   int bishopShifts[64];
-  bool inFilter = false;
-  std::map<u64,u64> rookMoves[64];//key, moves bitboard 
-  std::map<u64,u64> bishopMoves[64];//key, moves bitboard 
+  u64 const *rookMoves[64];//indexed by key, moves bitboard 
+  u64 const *bishopMoves[64];//indexed by key, moves bitboard 
+  u64 rookOffsets[64];//offset of each square into sliderTable
+  u64 bishopOffsets[64];
+  std::shared_ptr<const u64> sliderTable;//huge page block or a read only mapping of the attack cache
+  u64 sliderTableSize = 0;
+  std::string attackCachePath;
   
   void generateKnightMoves();//fills the knight moves array, does not do actual move generation
   void generateKingMoves();//see above comment
+  void generatePawnCaptures();
   void generateFileMasks();
   void generateRankMasks();
   void generateRookMasks();
   void generateBishopMasks();
-  void fillRookMoves();
-  void fillBishopMoves();
+  void fillSliderMoves();
+  void setSliderPointers();
+  bool loadAttackCache();
+  bool saveAttackCache();
+  u64 computeSlidingMoves(int square, u64 blocker, bool rook);
 
   //Used for magic number search
   std::vector<u64> rookBlockers[64];
   std::vector<u64> bishopBlockers[64];
-  bool testMagic(std::vector<u64> *blockers, int square, u64 magic, int shift);
   void generateBlockersFromMask(u64 mask,std::vector<u64> &target);
   void generateRookBlockers();
   void generateBishopBlockers();
@@ -53,30 +138,119 @@ class Search{
   u64 friendlyBitboard;
   u64 enemyBitboard;
   int color;
-  int threatenedIndex;//>:}
-  void addMovesToSquares(MoveList &moves, int fromSquare, u64 squares);
-  void addMovesFromOffset(MoveList &moves, int offset, u64 targets, byte flags = 0);
-  void addDiagonalMoves(Board &board, int square, MoveList &moves);
-  void addHorizontalMoves(Board &board, int square, MoveList &moves);
-  void addPawnMoves(Board &board, MoveList &moves);
-  void addSlidingMoves(Board &board, MoveList &moves);
-  void addKnightMoves(Board &board, MoveList &moves);
-  void addKingMoves(Board &board, MoveList &moves);
-  void addCastlingMoves(Board &board, MoveList &moves);
-  void filterLegalMoves(Board board, MoveList &moves);
-  bool isAttacked(Board const &board, byte square, byte opponentColor);
+  Move *cursor;//where the add functions write the next move
+  MoveArena<Move> moveArena;
+  MoveArena<ScoredMove> scoredArena;
+  void addMovesToSquares(int fromSquare, u64 squares);
+  void addMovesFromOffset(int offset, u64 targets, byte flags = 0);
+  void addDiagonalMoves(Position const &board, int square);
+  void addHorizontalMoves(Position const &board, int square);
+  void addPawnMoves(Position const &board);
+  template<int dir> void addPawnMoves(Position const &board);
+  void addSlidingMoves(Position const &board);
+  void addKnightMoves(Position const &board);
+  void addKingMoves(Position const &board);
+  void addCastlingMoves(Position const &board, AttackInfo const &info);
+  Move *generateMoves(Position const &board, AttackInfo const &info, Move *moves);//writes the legal moves, returns the end
+  Move *generateMoves(Position const &board, Move *moves){return generateMoves(board, computeAttackInfo(board), moves);}
+  Move *filterLegalMoves(Position const &board, AttackInfo const &info, Move *begin, Move *end);
+  void generateMoves(Position const &board, PlyMoves<Move> &moves);
+  void generateOrderedMoves(Board &board, PlyMoves<ScoredMove> &moves, Move hashMove = Move());
+  bool isAttacked(Position const &board, byte square, byte opponentColor);
+  //evaluation, see Eval/eval.cpp
+  PawnHashTable pawnTable;
+  EvalCache evalCache;
+  PawnEntry pawnScratch;//used instead of the pawn table when caching is off
+  PawnEntry const &pawnStructure(Position const &board);
+  int computeEvaluation(Position const &board);//white's point of view, no eval cache
+  //alpha beta
+  bool isCapture(Position const &board, Move m);
+  short moveScore(Position const &board, Move m);
+  int quiescence(Board &board, int alpha, int beta, int ply, bool trackPV = false);
+  int alphaBeta(Board &board, int depth, int alpha, int beta, int ply, bool allowNull = true);
+  Move rootSearch(Board &board, int depth, int &score, Move previous, std::vector<Move> const &excluded = {});
+  Move pvTable[MAX_SEARCH_PLY][MAX_SEARCH_PLY];//triangular, the line found at ply is pvTable[ply][ply..pvLength[ply])
+  int pvLength[MAX_SEARCH_PLY];
+  void updatePV(int ply, Move m);
+  void extendPV(Board &board, std::vector<Move> &pv, int length);
+  u64 nodeLimit = 0;
+  bool stopped = false;
+  //mate solver, see Mate/dfpn.cpp
+  u64 mateKey(Position const &board, int plies, bool attacking) const;
+  void mateSearch(Board &board, int plies, bool attacking, unsigned int phiLimit, unsigned int deltaLimit);
+  bool proveMate(Board &board, int plies, bool attacking);//true when the attacker mates within plies
+  std::vector<Move> mateLine(Board &board, int plies, bool attacking);
   //testing
   u64 perftTest(Board &b, int depth, bool root = true);
+  u64 perftCopyTest(Position *positions, int depth);
+  std::vector<Position> randomGamePositions(int count);
   
 public:
-  Search();
+  Search(std::string attackCache = "");//if set, slider tables are mapped from this file, or built and written to it
   u64 rankMasks[8] = {};
   u64 fileMasks[8] = {};
 
-  void generateMoves(Board &board, MoveList &moves);
-  void searchForMagics();
-  void saveMagics();
+  PageBacking sliderTableBacking = PAGES_NORMAL;//normal when mapped from the attack cache
+  u64 nodes = 0;//nodes visited by the last search
+  SearchFeatures features;
+  EvalStats evalStats;//since the search was created or the stats were last taken
+  bool evalCaching = true;//the pawn hash table and eval cache, off to measure them
+  std::shared_ptr<const OpeningBook> book;//probed by searchBestMove before searching, shared between copies
+  std::shared_ptr<const Bitbases> bitbases;//probed by alphaBeta in positions with 4 pieces or less
+  std::shared_ptr<TranspositionTable> tt;//used by the search when set, not safe to share between threads
+  std::shared_ptr<PositionCache> positionCache;//probed by alphaBeta and perft when set, safe to share between threads and processes
+  u64 scoreFingerprint() const;//hash of what search scores depend on: the eval weights, the enabled features and bitbase use
+  std::shared_ptr<MateTable> mateTable;//node store of solveMate, made on first use
+
+  //attack lookups, the piece's own square is not included
+  inline u64 rookAttacks(int square, u64 occupancy) const {
+    return rookMoves[square][((occupancy & rookMasks[square]) * rookMagics[square]) >> rookShifts[square]] & ~((u64)1<<square);
+  }
+  inline u64 bishopAttacks(int square, u64 occupancy) const {
+    return bishopMoves[square][((occupancy & bishopMasks[square]) * bishopMagics[square]) >> bishopShifts[square]] & ~((u64)1<<square);
+  }
+  inline u64 knightAttacks(int square) const {return knightMoves[square];}
+  inline u64 kingAttacks(int square) const {return kingMoves[square];}
+
+  //attacks, see Attacks/attacks.cpp
+  u64 attackersTo(Position const &board, int square, u64 occupancy) const;//both colors
+  u64 attacks(Position const &board, int color, u64 occupancy) const;//every square color attacks
+  AttackInfo computeAttackInfo(Position const &board) const;
+  AttackInfo const &attackInfo(Board &board) const;//cached in the board's state stack
+  bool inCheck(Position const &board);
+  bool inCheck(Board &board);//uses the cached attack info
+
+  void generateMoves(Position const &board, MoveList &moves);
+  int evaluate(Position const &board);//for the side to move
+  void evaluationFeatures(Position const &board, std::vector<EvalFeature> &features);//appends the nonzero counts, for tuning
+  int pieceValue(byte piece);
+  Move findBestMove(Board &board, int depth, int &score);
+  Move searchBestMove(Board &board, int maxDepth, u64 maxNodes, int &score);
+  //iterative deepening for the best few root moves, each line is a full search that excludes the root moves found before it
+  //report is called after every finished depth, maxNodes = 0 is no limit
+  std::vector<AnalysisLine> analyze(Board &board, int maxDepth, int lines, u64 maxNodes,
+                                    std::function<void(int depth, std::vector<AnalysisLine> const &lines)> const &report);
+  bool isMate(Board &board);//in check with no legal moves
+  //proof-number search for a mate in maxMoves or less by either side, shortest first, maxNodes = 0 is no limit
+  MateResult solveMate(Board &board, int maxMoves, u64 maxNodes = 0);
+  std::vector<Move> quietLine(Board &board);//the captures the capture search expects, playing them reaches a quiet position
+  std::vector<Move> principalVariation() const {return std::vector<Move>(pvTable[0], pvTable[0]+pvLength[0]);}//of the last root search
+  u64 perft(Board &board, int depth){return perftTest(board, depth, false);}
+  u64 perftCopyMake(Position const &position, int depth);
+  bool searchForMagics(int seconds = 10, int threads = 0, u64 seed = 1);//threads = 0 uses every core
+  bool saveMagics();
   void loadMagics();
   void runMoveGenerationTest(Board &board);
   void runMoveGenerationSuite();
+  void runBench(int depth = 0);//depth 0 uses the built in depths
+  void runCopyMakeBench();//perft with make/unmake against copy-make
+  void runPageBench(int hashMegabytes = 256);//perft and search speed on normal pages against huge pages
+  void runFENBench();//fen parse and serialize speed
+  void runPackedBench();//PackedBoard encode and decode speed
+  void runAttackBench();//whole-side slider attacks, magics against the fill kernels
+  void runBatchBench();//legal move counts one position at a time against the batch kernels
+  void runMultiPVBench(int depth = 0);//cost of 1, 2, 4 and 8 lines against a single line search
+  void runSelectiveBench(int depth = 0);//nodes and time to depth with each selective technique against a plain alpha-beta
+  void runEvalBench();//eval ns/call and search speed with and without the pawn hash table and eval cache
+  void runMateBench();//the mate solver against plain alpha-beta on mate in n positions
 };
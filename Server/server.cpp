@@ -0,0 +1,405 @@
+#include "server.h"
+#include "../ui/debug.h"
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define LATENCY_SAMPLES 10000
+#define MAX_LINE_LENGTH 4096
+#define MAX_OUTPUT_BACKLOG (1<<20)//bytes of responses a client has not read yet before it is dropped
+
+namespace{
+volatile std::sig_atomic_t interrupted = 0;
+void onSignal(int){interrupted = 1;}
+}
+
+//closed when the last request that needs it has answered, even if the client is gone
+//the socket is non-blocking: responses go to an output queue, as much as the socket takes is written at once
+//and the poll thread writes the rest when the socket is writable, so no thread ever waits on a slow client
+struct AnalysisServer::Connection{
+  int fd;
+  int wakeFd;//the poll thread's pipe, written when output is left for it to flush
+  std::mutex writeLock;
+  std::string output;//responses not yet taken by the socket
+  std::atomic<bool> dropped{false};//gone or too far behind, the poll thread forgets it
+  std::string buffer;//bytes read but not yet a full line
+  Connection(int fd, int wakeFd) : fd(fd), wakeFd(wakeFd) {}
+  ~Connection(){close(fd);}
+  void send(std::string const &response){
+    std::lock_guard<std::mutex> guard(writeLock);
+    if(dropped) return;
+    bool waiting = !output.empty();
+    output += response;
+    output += '\n';
+    if(output.size() > MAX_OUTPUT_BACKLOG){
+      drop();
+      return;
+    }
+    flushLocked();
+    if(!waiting && !output.empty()){
+      //the poll thread starts watching for POLLOUT, a full pipe means it is awake already
+      ssize_t woken = write(wakeFd, "", 1);
+      (void)woken;
+    }
+  }
+  void flush(){
+    std::lock_guard<std::mutex> guard(writeLock);
+    flushLocked();
+  }
+  bool pending(){
+    std::lock_guard<std::mutex> guard(writeLock);
+    return !output.empty();
+  }
+private:
+  void flushLocked(){
+    size_t sent = 0;
+    while(sent < output.size()){
+      ssize_t n = ::send(fd, output.data()+sent, output.size()-sent, MSG_NOSIGNAL);
+      if(n > 0){
+        sent += n;
+        continue;
+      }
+      if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+      drop();//the client went away, its responses are dropped
+      return;
+    }
+    output.erase(0, sent);
+  }
+  void drop(){
+    dropped = true;
+    output.clear();
+    output.shrink_to_fit();
+    shutdown(fd, SHUT_RDWR);
+  }
+};
+
+AnalysisServer::AnalysisServer(Search const &search, ServerOptions options) : options(options), search(search){
+  if(this->options.threads <= 0) this->options.threads = std::max(1u, std::thread::hardware_concurrency());
+}
+
+bool AnalysisServer::run(){
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if(listener < 0){
+    std::cout<<"[error] Could not create a socket"<<std::endl;
+    return false;
+  }
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  if(options.socketPath.size() >= sizeof(address.sun_path)){
+    std::cout<<"[error] Socket path is too long"<<std::endl;
+    close(listener);
+    return false;
+  }
+  std::copy(options.socketPath.begin(), options.socketPath.end(), address.sun_path);
+  unlink(options.socketPath.c_str());//left over from a server that did not shut down
+  if(bind(listener, (sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 64) != 0){
+    std::cout<<"[error] Could not listen on "<<options.socketPath<<std::endl;
+    close(listener);
+    return false;
+  }
+  int wakeup[2];
+  if(pipe(wakeup) != 0){
+    std::cout<<"[error] Could not create a pipe"<<std::endl;
+    close(listener);
+    return false;
+  }
+  fcntl(wakeup[0], F_SETFL, O_NONBLOCK);
+  fcntl(wakeup[1], F_SETFL, O_NONBLOCK);
+  std::signal(SIGINT, onSignal);
+  std::signal(SIGTERM, onSignal);
+  std::vector<std::thread> workers;
+  for(int i = 0; i<options.threads; i++){
+    workers.emplace_back(&AnalysisServer::work, this);
+  }
+  std::cout<<"[serving on "<<options.socketPath<<" with "<<options.threads<<" workers]"<<std::endl;
+
+  //one thread reads every connection and flushes what the workers could not write
+  std::vector<std::shared_ptr<Connection>> connections;
+  char data[4096];
+  while(!interrupted){
+    std::vector<pollfd> fds(2 + connections.size());
+    fds[0] = {listener, POLLIN, 0};
+    fds[1] = {wakeup[0], POLLIN, 0};
+    for(size_t i = 0; i<connections.size(); i++){
+      fds[i+2] = {connections[i]->fd, (short)(POLLIN | (connections[i]->pending() ? POLLOUT : 0)), 0};
+    }
+    if(poll(fds.data(), fds.size(), 200) <= 0) continue;
+    if(fds[1].revents & POLLIN){
+      while(read(wakeup[0], data, sizeof(data)) > 0);
+    }
+    for(size_t i = connections.size(); i-- > 0;){
+      std::shared_ptr<Connection> connection = connections[i];
+      if(fds[i+2].revents & POLLOUT) connection->flush();
+      if(connection->dropped){
+        connections.erase(connections.begin()+i);
+        continue;
+      }
+      if(!(fds[i+2].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+      ssize_t n = read(connection->fd, data, sizeof(data));
+      if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) continue;
+      if(n <= 0){
+        connections.erase(connections.begin()+i);
+        continue;
+      }
+      connection->buffer.append(data, n);
+      size_t end;
+      while((end = connection->buffer.find('\n')) != std::string::npos){
+        std::string line = connection->buffer.substr(0, end);
+        connection->buffer.erase(0, end+1);
+        receive(connection, line);
+      }
+      if(connection->buffer.size() > MAX_LINE_LENGTH){
+        connection->send("{\"id\": null, \"error\": \"line too long\"}");
+        connections.erase(connections.begin()+i);
+      }
+    }
+    if(fds[0].revents & POLLIN){
+      int fd = accept(listener, nullptr, nullptr);
+      if(fd >= 0){
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        connections.push_back(std::make_shared<Connection>(fd, wakeup[1]));
+      }
+    }
+  }
+
+  std::cout<<"[shutting down]"<<std::endl;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stopping = true;
+  }
+  requestReady.notify_all();
+  for(std::thread &t : workers) t.join();
+  connections.clear();
+  close(wakeup[0]);
+  close(wakeup[1]);
+  close(listener);
+  unlink(options.socketPath.c_str());
+  return true;
+}
+
+//parse errors, stats and overload are answered here, everything else is queued
+void AnalysisServer::receive(std::shared_ptr<Connection> const &connection, std::string const &line){
+  if(line.find_first_not_of(" \t\r") == std::string::npos) return;
+  Request request;
+  request.received = std::chrono::steady_clock::now();
+  if(!parseJsonObject(line, request.fields)){
+    connection->send("{\"id\": null, \"error\": \"invalid json\"}");
+    return;
+  }
+  std::string id = request.fields.count("id") ? request.fields["id"] : "null";
+  if(request.fields.count("task") && jsonUnquote(request.fields["task"]) == "stats"){
+    connection->send("{\"id\": " + id + ", " + stats() + "}");
+    return;
+  }
+  request.connection = connection;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    if((int)queue.size() < options.maxQueue){
+      queue.push_back(std::move(request));
+      requestReady.notify_one();
+      return;
+    }
+  }
+  {
+    std::lock_guard<std::mutex> guard(statsLock);
+    rejected++;
+  }
+  connection->send("{\"id\": " + id + ", \"error\": \"overloaded\"}");
+}
+
+void AnalysisServer::work(){
+  Search localSearch = search;//shares the slider tables
+  localSearch.tt = std::make_shared<TranspositionTable>(options.hashMegabytes);
+  Board board;
+  while(true){
+    Request request;
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      requestReady.wait(guard, [&]{ return !queue.empty() || stopping; });
+      if(stopping) return;
+      request = std::move(queue.front());
+      queue.pop_front();
+    }
+    std::string id = request.fields.count("id") ? request.fields["id"] : "null";
+    std::string response = "{\"id\": " + id + ", " + handle(board, localSearch, request.fields) + "}";
+    //counted before sending, so a stats request sent after this response always includes it
+    recordLatency(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now()-request.received).count(), localSearch.evalStats);
+    localSearch.evalStats = EvalStats();
+    request.connection->send(response);
+  }
+}
+
+//returns the response fields without braces
+std::string AnalysisServer::handle(Board &board, Search &localSearch, std::map<std::string, std::string> const &fields){
+  auto field = [&](std::string const &name){ return fields.count(name) ? fields.at(name) : std::string(""); };
+  std::string task = jsonUnquote(field("task"));
+  std::string fen = field("fen") == "" ? "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1" : jsonUnquote(field("fen"));
+  if(!board.loadFromFEN(fen)) return "\"error\": \"invalid fen\"";
+  int depth = 0;
+  if(field("depth") != ""){
+    try{
+      depth = std::stoi(field("depth"));
+    }catch(std::exception const &){
+      return "\"error\": \"invalid depth\"";
+    }
+  }
+  bool whiteToMove = board.flags & WHITE_TO_MOVE_BIT;
+
+  if(task == "moves"){
+    MoveList moves;
+    localSearch.generateMoves(board, moves);
+    std::string list = "";
+    for(int i = 0; i<moves.end; i++){
+      list += (i ? ", " : "") + jsonString(debug::moveToUci(moves.moves[i], whiteToMove));
+    }
+    return "\"count\": " + std::to_string((int)moves.end) + ", \"moves\": [" + list + "]";
+  }
+  if(task == "perft"){
+    if(depth < 1 || depth > options.maxPerftDepth) return "\"error\": \"depth must be 1 to " + std::to_string(options.maxPerftDepth) + "\"";
+    return "\"nodes\": " + std::to_string(localSearch.perft(board, depth));
+  }
+  if(task == "search"){
+    if(depth == 0) depth = 4;
+    if(depth < 1 || depth > options.maxSearchDepth) return "\"error\": \"depth must be 1 to " + std::to_string(options.maxSearchDepth) + "\"";
+    std::vector<AnalysisLine> lines = localSearch.analyze(board, depth, 1, 0, nullptr);
+    if(lines.empty()){
+      int score = localSearch.inCheck(board) ? -MATE_SCORE : 0;
+      return "\"bestmove\": null, \"score\": " + std::to_string(score) + ", \"nodes\": 0, \"pv\": []";
+    }
+    std::string pv = "";
+    bool white = whiteToMove;
+    for(Move m : lines[0].pv){
+      pv += (pv == "" ? "" : ", ") + jsonString(debug::moveToUci(m, white));
+      white = !white;
+    }
+    return "\"bestmove\": " + jsonString(debug::moveToUci(lines[0].pv[0], whiteToMove)) + ", \"score\": " + std::to_string(lines[0].score)
+         + ", \"nodes\": " + std::to_string(localSearch.nodes) + ", \"pv\": [" + pv + "]";
+  }
+  if(task == "eval"){
+    return "\"eval\": " + std::to_string(localSearch.evaluate(board));
+  }
+  return "\"error\": \"unknown task, expected moves, perft, search, eval or stats\"";
+}
+
+void AnalysisServer::recordLatency(u64 microseconds, EvalStats const &eval){
+  std::lock_guard<std::mutex> guard(statsLock);
+  evalStats += eval;
+  if(latencies.size() < LATENCY_SAMPLES) latencies.push_back(microseconds);
+  else latencies[completed % LATENCY_SAMPLES] = microseconds;
+  completed++;
+}
+
+//queue depth, counters and latency percentiles of the last LATENCY_SAMPLES requests, from receiving the line to the finished response
+std::string AnalysisServer::stats(){
+  int queued;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    queued = queue.size();
+  }
+  std::vector<u64> sorted;
+  u64 done, refused;
+  EvalStats eval;
+  {
+    std::lock_guard<std::mutex> guard(statsLock);
+    eval = evalStats;
+    sorted = latencies;
+    done = completed;
+    refused = rejected;
+  }
+  std::sort(sorted.begin(), sorted.end());
+  auto percentile = [&](int p){ return sorted.empty() ? 0 : sorted[std::min(sorted.size()-1, sorted.size()*p/100)]; };
+  return "\"queue\": " + std::to_string(queued) + ", \"max_queue\": " + std::to_string(options.maxQueue)
+       + ", \"workers\": " + std::to_string(options.threads) + ", \"completed\": " + std::to_string(done)
+       + ", \"rejected\": " + std::to_string(refused) + ", \"p50_us\": " + std::to_string(percentile(50))
+       + ", \"p90_us\": " + std::to_string(percentile(90)) + ", \"p99_us\": " + std::to_string(percentile(99))
+       + ", \"max_us\": " + std::to_string(sorted.empty() ? 0 : sorted.back())
+       + ", \"eval_calls\": " + std::to_string(eval.calls) + ", \"eval_ns\": " + std::to_string(eval.nsPerCall())
+       + ", \"eval_cache_hit_rate\": " + std::to_string(eval.cacheHitRate()) + ", \"pawn_hash_hit_rate\": " + std::to_string(eval.pawnHitRate());
+}
+
+bool parseJsonObject(std::string const &text, std::map<std::string, std::string> &values){
+  size_t i = 0;
+  auto skipSpace = [&]{ while(i < text.size() && isspace((unsigned char)text[i])) i++; };
+  //a string starting at i, returned with its quotes and escapes as written
+  auto readString = [&](std::string &out){
+    if(i >= text.size() || text[i] != '"') return false;
+    size_t start = i++;
+    while(i < text.size() && text[i] != '"'){
+      if(text[i] == '\\') i++;
+      i++;
+    }
+    if(i >= text.size()) return false;
+    out = text.substr(start, ++i - start);
+    return true;
+  };
+  skipSpace();
+  if(i >= text.size() || text[i++] != '{') return false;
+  skipSpace();
+  if(i < text.size() && text[i] == '}') i++;
+  else while(true){
+    std::string key, value;
+    skipSpace();
+    if(!readString(key)) return false;
+    skipSpace();
+    if(i >= text.size() || text[i++] != ':') return false;
+    skipSpace();
+    if(i < text.size() && text[i] == '"'){
+      if(!readString(value)) return false;
+    }else{
+      size_t start = i;
+      while(i < text.size() && (isalnum((unsigned char)text[i]) || text[i] == '-' || text[i] == '+' || text[i] == '.')) i++;
+      value = text.substr(start, i-start);
+      bool number = value != "" && (isdigit((unsigned char)value[0]) || value[0] == '-');
+      if(!number && value != "true" && value != "false" && value != "null") return false;
+    }
+    values[jsonUnquote(key)] = value;
+    skipSpace();
+    if(i >= text.size()) return false;
+    if(text[i] == '}'){
+      i++;
+      break;
+    }
+    if(text[i++] != ',') return false;
+  }
+  skipSpace();
+  return i == text.size();
+}
+
+std::string jsonString(std::string const &s){
+  std::string out = "\"";
+  for(char c : s){
+    if(c == '"' || c == '\\') out.push_back('\\');
+    if((unsigned char)c < 0x20){
+      out += ' ';
+      continue;
+    }
+    out.push_back(c);
+  }
+  return out + "\"";
+}
+
+std::string jsonUnquote(std::string const &value){
+  if(value.size() < 2 || value[0] != '"') return value;
+  std::string out = "";
+  for(size_t i = 1; i+1<value.size(); i++){
+    if(value[i] == '\\' && i+2 < value.size()){
+      i++;
+      switch(value[i]){
+        case 'n': out.push_back('\n'); break;
+        case 't': out.push_back('\t'); break;
+        case 'r': out.push_back('\r'); break;
+        case 'b': out.push_back('\b'); break;
+        case 'f': out.push_back('\f'); break;
+        default: out.push_back(value[i]);//quotes, slashes, \u escapes are not decoded
+      }
+      continue;
+    }
+    out.push_back(value[i]);
+  }
+  return out;
+}
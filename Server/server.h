@@ -0,0 +1,64 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../Board/board.h"
+#include "../Search/search.h"
+
+struct ServerOptions{
+  std::string socketPath;
+  int threads = 0;//0 uses every core
+  int maxQueue = 256;//requests waiting for a worker, more are rejected
+  int hashMegabytes = 16;//per worker
+  int maxPerftDepth = 7;
+  int maxSearchDepth = 12;
+};
+
+//Serves newline delimited JSON requests on a Unix domain socket, one object per line:
+//  {"id": 1, "task": "moves" | "perft" | "search" | "eval" | "stats", "fen": "...", "depth": 4}
+//Requests are queued for a pool of workers that all copy one Search (the slider tables are shared, never rebuilt)
+//Responses carry the request id and are written as soon as they finish, so they can come back out of order
+//When the queue is full a request is answered at once with {"id": ..., "error": "overloaded"}
+//Sockets are non-blocking, a client that leaves more than MAX_OUTPUT_BACKLOG bytes of responses unread is disconnected
+class AnalysisServer{
+  struct Connection;
+  struct Request{
+    std::shared_ptr<Connection> connection;
+    std::map<std::string, std::string> fields;
+    std::chrono::steady_clock::time_point received;
+  };
+  ServerOptions options;
+  Search const &search;
+
+  std::mutex lock;
+  std::condition_variable requestReady;
+  std::deque<Request> queue;
+  bool stopping = false;
+
+  std::mutex statsLock;
+  std::vector<u64> latencies;//microseconds, a ring of the last LATENCY_SAMPLES responses
+  u64 completed = 0;
+  u64 rejected = 0;
+  EvalStats evalStats;//added up from every worker after each request
+
+  void receive(std::shared_ptr<Connection> const &connection, std::string const &line);
+  void work();
+  std::string handle(Board &board, Search &localSearch, std::map<std::string, std::string> const &fields);
+  std::string stats();
+  void recordLatency(u64 microseconds, EvalStats const &eval);
+public:
+  AnalysisServer(Search const &search, ServerOptions options);
+  bool run();//until SIGINT or SIGTERM
+};
+
+//flat JSON objects only: string, number, true, false and null values, values are kept as their JSON text
+bool parseJsonObject(std::string const &text, std::map<std::string, std::string> &values);
+std::string jsonString(std::string const &s);//quoted and escaped
+std::string jsonUnquote(std::string const &value);//the contents of a JSON string value
@@ -0,0 +1,267 @@
+#include "tuner.h"
+#include <cmath>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace{
+//splits [0, count) into one contiguous range per thread, work(thread, begin, end)
+void parallelFor(int threads, u64 count, std::function<void(int, u64, u64)> const &work){
+  std::vector<std::thread> pool;
+  for(int t = 0; t<threads; t++){
+    pool.emplace_back(work, t, count*t/threads, count*(t+1)/threads);
+  }
+  for(std::thread &t : pool) t.join();
+}
+
+double seconds(std::chrono::steady_clock::time_point start){
+  return std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+}
+
+double sigmoid(double score, double k){
+  return 1.0/(1.0 + std::pow(10.0, -k*score/400.0));
+}
+}
+
+size_t findResult(std::string const &line, float &result){
+  struct Token{
+    char const *text;
+    float result;
+  };
+  static Token const tokens[] = {{"1/2-1/2", 0.5f}, {"1-0", 1}, {"0-1", 0}, {"[1.0]", 1}, {"[0.5]", 0.5f}, {"[0.0]", 0}};
+  for(Token const &token : tokens){
+    size_t at = line.find(token.text);
+    if(at == std::string::npos) continue;
+    result = token.result;
+    if(at > 0 && line[at-1] == '"') at--;//c9 "1-0";
+    return at;
+  }
+  return std::string::npos;
+}
+
+Tuner::Tuner(Search const &search, TunerOptions options) : options(options), search(search){
+  if(this->options.threads <= 0) this->options.threads = std::max(1u, std::thread::hardware_concurrency());
+}
+
+//every thread plays the capture search line of its positions and keeps the features of the quiet position it ends in
+//the blocks of the threads are appended in order, so the dataset order is kept
+void Tuner::reduce(u64 count, std::function<bool(u64, Board &, float &)> const &decode){
+  int threads = std::max<u64>(1, std::min<u64>(options.threads, count));
+  std::vector<std::vector<EvalFeature>> threadFeatures(threads);
+  std::vector<std::vector<u64>> threadSizes(threads);
+  std::vector<std::vector<float>> threadResults(threads);
+  parallelFor(threads, count, [&](int thread, u64 begin, u64 end){
+    Search localSearch = search;//shares the slider tables
+    Board board;
+    std::vector<EvalFeature> position;
+    for(u64 i = begin; i<end; i++){
+      float result;
+      if(!decode(i, board, result)) continue;
+      for(Move move : localSearch.quietLine(board)) board.makeMove(move);
+      position.clear();
+      localSearch.evaluationFeatures(board, position);
+      //the features have to add up to the real evaluation, or the tuned weights mean something else
+      int sum = 0;
+      for(EvalFeature const &feature : position) sum += evalWeights[feature.index]*feature.count;
+      int score = localSearch.evaluate(board);
+      if(sum != ((board.flags & WHITE_TO_MOVE_BIT) ? score : -score)) mismatches++;
+      threadFeatures[thread].insert(threadFeatures[thread].end(), position.begin(), position.end());
+      threadSizes[thread].push_back(position.size());
+      threadResults[thread].push_back(result);
+    }
+  });
+  for(int t = 0; t<threads; t++){
+    features.insert(features.end(), threadFeatures[t].begin(), threadFeatures[t].end());
+    for(u64 size : threadSizes[t]) offsets.push_back(offsets.back() + size);
+    results.insert(results.end(), threadResults[t].begin(), threadResults[t].end());
+  }
+}
+
+//datagen records are mapped rather than read, the page cache holds them and nothing is copied
+bool Tuner::loadRecords(){
+  int fd = ::open(options.dataset.c_str(), O_RDONLY);
+  struct stat st;
+  if(fd < 0 || fstat(fd, &st) != 0){
+    if(fd >= 0) close(fd);
+    std::cout<<"[error] Could not open "<<options.dataset<<std::endl;
+    return false;
+  }
+  u64 count = st.st_size/sizeof(TrainingRecord);
+  if(st.st_size % sizeof(TrainingRecord)) std::cout<<"[warning] "<<options.dataset<<" ends with a partial record"<<std::endl;
+  if(count == 0){
+    close(fd);
+    return true;
+  }
+  void *mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(mapped == MAP_FAILED){
+    std::cout<<"[error] Could not map "<<options.dataset<<std::endl;
+    return false;
+  }
+  madvise(mapped, st.st_size, MADV_SEQUENTIAL);
+  TrainingRecord const *records = (TrainingRecord const *)mapped;
+  reduce(count, [&](u64 i, Board &board, float &result){
+    result = (records[i].result + 1)*0.5f;
+    return records[i].position.decode(board);//a damaged record is skipped
+  });
+  munmap(mapped, st.st_size);
+  return true;
+}
+
+//streamed a block of lines at a time, an epd file never has to fit in memory as text
+bool Tuner::loadEPD(){
+  std::ifstream in(options.dataset);
+  if(!in.is_open()){
+    std::cout<<"[error] Could not open "<<options.dataset<<std::endl;
+    return false;
+  }
+  std::vector<std::string> block;
+  std::string line;
+  while(true){
+    bool more = (bool)std::getline(in, line);
+    if(more && !line.empty()) block.push_back(line);
+    if(block.size() < TUNER_EPD_BLOCK && more) continue;
+    reduce(block.size(), [&](u64 i, Board &board, float &result){
+      size_t end = findResult(block[i], result);
+      return end != std::string::npos && board.loadFromFEN(std::string_view(block[i]).substr(0, end));
+    });
+    block.clear();
+    if(!more) break;
+  }
+  return true;
+}
+
+double Tuner::error(std::vector<double> const &weights, double k, int threads){
+  std::vector<double> sums(threads);
+  parallelFor(threads, results.size(), [&](int thread, u64 begin, u64 end){
+    double sum = 0;
+    for(u64 i = begin; i<end; i++){
+      double score = 0;
+      for(u64 f = offsets[i]; f<offsets[i+1]; f++) score += weights[features[f].index]*features[f].count;
+      double miss = results[i] - sigmoid(score, k);
+      sum += miss*miss;
+    }
+    sums[thread] = sum;
+  });
+  double total = 0;
+  for(double sum : sums) total += sum;
+  return total/results.size();
+}
+
+//gradient of the mean squared error, every thread fills its own array and they are added at the end
+double Tuner::gradient(std::vector<double> const &weights, double k, int threads, std::vector<double> &sum){
+  std::vector<std::vector<double>> gradients(threads, std::vector<double>(EVAL_WEIGHTS));
+  std::vector<double> errors(threads);
+  parallelFor(threads, results.size(), [&](int thread, u64 begin, u64 end){
+    std::vector<double> &local = gradients[thread];
+    double error = 0;
+    for(u64 i = begin; i<end; i++){
+      double score = 0;
+      for(u64 f = offsets[i]; f<offsets[i+1]; f++) score += weights[features[f].index]*features[f].count;
+      double predicted = sigmoid(score, k);
+      double miss = results[i] - predicted;
+      error += miss*miss;
+      double slope = miss*predicted*(1-predicted);
+      for(u64 f = offsets[i]; f<offsets[i+1]; f++) local[features[f].index] += slope*features[f].count;
+    }
+    errors[thread] = error;
+  });
+  double scale = -2.0*k*std::log(10.0)/400.0/results.size();
+  double error = 0;
+  sum.assign(EVAL_WEIGHTS, 0);
+  for(int t = 0; t<threads; t++){
+    for(int w = 0; w<EVAL_WEIGHTS; w++) sum[w] += gradients[t][w]*scale;
+    error += errors[t];
+  }
+  return error/results.size();
+}
+
+//coarse scan, then a finer one around the best
+double Tuner::fitK(std::vector<double> const &weights){
+  double best = 1, bestError = 1e9;
+  for(double k = 0.05; k<=3; k += 0.05){
+    double e = error(weights, k, options.threads);
+    if(e < bestError) bestError = e, best = k;
+  }
+  double center = best;
+  for(double k = center-0.05; k<=center+0.05; k += 0.005){
+    double e = error(weights, k, options.threads);
+    if(k > 0 && e < bestError) bestError = e, best = k;
+  }
+  return best;
+}
+
+//one gradient pass at 1, 2, 4... threads, the speedup shows how much of an epoch is memory bound
+void Tuner::measureScaling(std::vector<double> const &weights, double k){
+  std::vector<int> counts;
+  for(int t = 1; t<options.threads; t *= 2) counts.push_back(t);
+  counts.push_back(options.threads);
+  std::vector<double> sum;
+  double single = 0;
+  for(int threads : counts){
+    auto start = std::chrono::steady_clock::now();
+    int passes = 0;
+    do{
+      gradient(weights, k, threads, sum);
+      passes++;
+    }while(seconds(start) < 0.5);
+    double perPass = seconds(start)/passes;
+    if(threads == 1) single = perPass;
+    std::cout<<"threads "<<threads<<": "<<1/perPass<<" epochs/s, "<<(u64)(results.size()/perPass)<<" positions/s";
+    std::cout<<", speedup "<<single/perPass<<"x"<<std::endl;
+  }
+}
+
+bool Tuner::run(){
+  std::cout<<"[tuning "<<EVAL_WEIGHTS<<" weights on "<<options.threads<<" threads]"<<std::endl;
+  auto start = std::chrono::steady_clock::now();
+  bool binary = options.dataset.size() > 4 && options.dataset.substr(options.dataset.size()-4) == ".bin";
+  if(!(binary ? loadRecords() : loadEPD())) return false;
+  if(results.empty()){
+    std::cout<<"[error] No positions in "<<options.dataset<<std::endl;
+    return false;
+  }
+  double loadTime = seconds(start);
+  std::cout<<"Loaded "<<results.size()<<" quiet positions, "<<features.size()<<" features in "<<loadTime<<"s";
+  std::cout<<" ("<<(u64)(results.size()/loadTime)<<" positions/s)"<<std::endl;
+  if(mismatches.load()){
+    std::cout<<"[error] The features of "<<mismatches.load()<<" positions do not add up to their evaluation"<<std::endl;
+    return false;
+  }
+
+  std::vector<double> weights(evalWeights, evalWeights+EVAL_WEIGHTS);
+  double k = options.k > 0 ? options.k : fitK(weights);
+  double startError = error(weights, k, options.threads);
+  std::cout<<"K "<<k<<", error "<<startError<<std::endl;
+  measureScaling(weights, k);
+
+  //adam, the step is about the learning rate whatever the scale of the gradient
+  double beta1 = 0.9, beta2 = 0.999;
+  std::vector<double> momentum(EVAL_WEIGHTS), velocity(EVAL_WEIGHTS), sum;
+  double currentError = startError;
+  start = std::chrono::steady_clock::now();
+  for(int epoch = 1; epoch<=options.epochs; epoch++){
+    currentError = gradient(weights, k, options.threads, sum);
+    for(int w = 0; w<EVAL_WEIGHTS; w++){
+      momentum[w] = beta1*momentum[w] + (1-beta1)*sum[w];
+      velocity[w] = beta2*velocity[w] + (1-beta2)*sum[w]*sum[w];
+      double m = momentum[w]/(1-std::pow(beta1, epoch));
+      double v = velocity[w]/(1-std::pow(beta2, epoch));
+      weights[w] -= options.learningRate*m/(std::sqrt(v) + 1e-8);
+    }
+    if(epoch % TUNER_REPORT_EPOCHS == 0 || epoch == options.epochs){
+      double elapsed = seconds(start);
+      std::cout<<"epoch "<<epoch<<" error "<<currentError<<" ("<<epoch/elapsed<<" epochs/s, ";
+      std::cout<<(u64)(epoch*results.size()/elapsed)<<" positions/s)"<<std::endl;
+    }
+  }
+
+  std::vector<int> rounded(EVAL_WEIGHTS);
+  for(int w = 0; w<EVAL_WEIGHTS; w++) rounded[w] = (int)std::lround(weights[w]);
+  std::vector<double> roundedWeights(rounded.begin(), rounded.end());
+  std::cout<<"Error "<<startError<<" -> "<<error(roundedWeights, k, options.threads)<<std::endl;
+  if(!saveEvalWeights(options.output, rounded.data())) return false;
+  std::cout<<"Wrote the weights to "<<options.output<<", use them with --eval="<<options.output<<std::endl;
+  return true;
+}
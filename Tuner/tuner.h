@@ -0,0 +1,52 @@
+#pragma once
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../Board/board.h"
+#include "../Search/search.h"
+#include "../Datagen/datagen.h"
+
+#define TUNER_EPD_BLOCK 65536//epd lines read before a block is reduced in parallel
+#define TUNER_REPORT_EPOCHS 10//one progress line every this many epochs
+
+struct TunerOptions{
+  std::string dataset;//.bin records from datagen, anything else is read as epd lines with a result
+  std::string output;//the tuned weights, load them with --eval=FILE
+  int epochs = 200;
+  int threads = 0;//0 uses every core
+  double learningRate = 1;//adam step, about a centipawn per epoch
+  double k = 0;//sigmoid scale, 0 fits it to the dataset before tuning
+};
+
+//Texel tuning: every position is reduced to the quiet position at the end of its capture search line,
+//then the weights are fitted so the sigmoid of the evaluation predicts the game results
+//The evaluation is linear in the weights, so each position is kept only as its feature counts
+//Epochs are full passes, threads accumulate gradients over their share of the positions and the sums are added
+class Tuner{
+  TunerOptions options;
+  Search const &search;
+  //position i has the features features[offsets[i]] to features[offsets[i+1]-1]
+  std::vector<EvalFeature> features;
+  std::vector<u64> offsets = {0};
+  std::vector<float> results;//1 white won, 0.5 draw, 0 black won
+  std::atomic<u64> mismatches{0};//feature sums that disagreed with Search::evaluate
+
+  bool loadRecords();
+  bool loadEPD();
+  //decode(i, board, result) fills in position i, false skips it
+  void reduce(u64 count, std::function<bool(u64, Board &, float &)> const &decode);
+  double error(std::vector<double> const &weights, double k, int threads);
+  double gradient(std::vector<double> const &weights, double k, int threads, std::vector<double> &sum);//returns the error
+  double fitK(std::vector<double> const &weights);
+  void measureScaling(std::vector<double> const &weights, double k);
+public:
+  Tuner(Search const &search, TunerOptions options);
+  bool run();
+};
+
+//"1-0", "0-1", "1/2-1/2", [1.0], [0.5] or [0.0] anywhere in the line, npos if there is none
+size_t findResult(std::string const &line, float &result);
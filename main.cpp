@@ -1,16 +1,302 @@
 #include <iostream>
 #include <string>
+#include <vector>
 
 #include "Board/board.h"
 #include "Search/search.h"
+#include "Search/Attacks/fill.h"
 #include "ui/ui.h"
+#include "Batch/batch.h"
+#include "Datagen/datagen.h"
+#include "Tuner/tuner.h"
+#include "Match/match.h"
+#include "Server/server.h"
 
-int main() {
+int main(int argc, char *argv[]) {
+  //options start with "--" and can appear anywhere, everything else is the mode and its arguments
+  std::vector<std::string> args;
+  std::string attackCache = "";
+  std::string bookPath = "";
+  std::string bitbasePath = "";
+  int hashMegabytes = 16;
+  std::string positionCachePath = "";
+  int positionCacheMegabytes = 64;
+  std::vector<std::string> disabledFeatures;
+  std::string evalPath = "";
+  double sprtElo0 = 0, sprtElo1 = 5;
+  for(int i = 1; i<argc; i++){
+    std::string arg = argv[i];
+    if(arg.rfind("--attack-cache=", 0) == 0){
+      attackCache = arg.substr(15);
+      continue;
+    }
+    if(arg.rfind("--book=", 0) == 0){
+      bookPath = arg.substr(7);
+      continue;
+    }
+    if(arg.rfind("--bitbases=", 0) == 0){
+      bitbasePath = arg.substr(11);
+      continue;
+    }
+    if(arg.rfind("--hash=", 0) == 0){
+      hashMegabytes = std::stoi(arg.substr(7));
+      continue;
+    }
+    if(arg.rfind("--position-cache=", 0) == 0){
+      positionCachePath = arg.substr(17);
+      continue;
+    }
+    if(arg.rfind("--position-cache-size=", 0) == 0){
+      positionCacheMegabytes = std::stoi(arg.substr(22));
+      continue;
+    }
+    if(arg.rfind("--disable=", 0) == 0){
+      //comma separated selective search techniques, see SearchFeatures
+      std::string list = arg.substr(10);
+      for(size_t start = 0, end; start <= list.size(); start = end+1){
+        end = list.find(',', start);
+        if(end == std::string::npos) end = list.size();
+        if(end > start) disabledFeatures.push_back(list.substr(start, end-start));
+      }
+      continue;
+    }
+    if(arg.rfind("--eval=", 0) == 0){
+      evalPath = arg.substr(7);
+      continue;
+    }
+    if(arg.rfind("--sprt=", 0) == 0){
+      //elo0,elo1 of the match sprt
+      size_t comma = arg.find(',');
+      sprtElo0 = std::stod(arg.substr(7, comma-7));
+      if(comma != std::string::npos) sprtElo1 = std::stod(arg.substr(comma+1));
+      continue;
+    }
+    if(arg == "--no-huge-pages"){
+      useHugePages = false;
+      continue;
+    }
+    if(arg == "--no-avx2"){
+      slidingAttacks = slidingAttacksScalar;
+      continue;
+    }
+    args.push_back(arg);
+  }
+  std::string mode = args.size() > 0 ? args[0] : "";
+  //weights written by the tuner, everything else keeps the hand written ones
+  if(evalPath != "" && !loadEvalWeights(evalPath)) return 1;
   std::cout<<"[creating board...]\n";
   Board board;
   board.loadFromFEN("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
   std::cout<<"[creating search...]\n";
-  Search search;
+  Search search(attackCache);
+  for(std::string const &name : disabledFeatures){
+    if(!search.features.set(name, false)){
+      std::cout<<"[error] Unknown search feature "<<name<<", expected pvs, nmp, lmr, rfp, futility, razoring or checkext"<<std::endl;
+      return 1;
+    }
+  }
+  if(bookPath != ""){
+    auto book = std::make_shared<OpeningBook>();
+    if(book->open(bookPath)) search.book = book;
+  }
+  if(bitbasePath != ""){
+    //generated once and saved, later runs load the file
+    auto bitbases = std::make_shared<Bitbases>();
+    if(!bitbases->load(bitbasePath)){
+      std::cout<<"[generating bitbases...]\n";
+      bitbases->build(search);
+      bitbases->save(bitbasePath);
+    }
+    std::cout<<"[bitbases: "<<bitbases->size()/1024<<" KB]\n";
+    search.bitbases = bitbases;
+  }
+  if(positionCachePath != ""){
+    //results from earlier runs (and other processes using the same file) are reused
+    auto cache = std::make_shared<PositionCache>();
+    if(cache->open(positionCachePath, search.scoreFingerprint(), positionCacheMegabytes)) search.positionCache = cache;
+  }
+  if(mode == "bench"){
+    if(args.size() > 1 && args[1] == "fen"){
+      search.runFENBench();
+      return 0;
+    }
+    if(args.size() > 1 && args[1] == "copymake"){
+      search.runCopyMakeBench();
+      return 0;
+    }
+    if(args.size() > 1 && args[1] == "eval"){
+      search.runEvalBench();
+      return 0;
+    }
+    if(args.size() > 1 && args[1] == "mate"){
+      search.runMateBench();
+      return 0;
+    }
+    if(args.size() > 1 && args[1] == "selective"){
+      search.runSelectiveBench(args.size() > 2 ? std::stoi(args[2]) : 0);
+      return 0;
+    }
+    if(args.size() > 1 && args[1] == "pages"){
+      search.runPageBench(args.size() > 2 ? std::stoi(args[2]) : 256);
+      return 0;
+    }
+    if(args.size() > 1 && args[1] == "attacks"){
+      search.runAttackBench();
+      return 0;
+    }
+    if(args.size() > 1 && args[1] == "batch"){
+      search.runBatchBench();
+      return 0;
+    }
+    if(args.size() > 1 && args[1] == "multipv"){
+      search.runMultiPVBench(args.size() > 2 ? std::stoi(args[2]) : 0);
+      return 0;
+    }
+    if(args.size() > 1 && args[1] == "packed"){
+      search.runPackedBench();
+      return 0;
+    }
+    int depth = args.size() > 1 ? std::stoi(args[1]) : 0;
+    if(depth < 0 || depth > MAX_PERFT_DEPTH){
+      std::cout<<"[error] The bench depth must be 0 to "<<MAX_PERFT_DEPTH<<std::endl;
+      return 1;
+    }
+    search.runBench(depth);
+    return 0;
+  }
+  if(mode == "magics"){
+    //magics [seconds] [threads] [seed]
+    search.searchForMagics(args.size() > 1 ? std::stoi(args[1]) : 60,
+                           args.size() > 2 ? std::stoi(args[2]) : 0,
+                           args.size() > 3 ? std::stoull(args[3]) : 1);
+    return 0;
+  }
+  if(mode == "analyze"){
+    //analyze <fen> [depth] [lines] [nodes]
+    if(args.size() < 2 || !board.loadFromFEN(args[1])){
+      std::cout<<"usage: analyze \"<fen>\" [depth] [lines] [nodes]"<<std::endl;
+      return 1;
+    }
+    search.tt = std::make_shared<TranspositionTable>(hashMegabytes);
+    std::cout<<"[hash: "<<search.tt->size()/(1024*1024)<<" MB, "<<pageBackingName(search.tt->backing)<<"]\n";
+    bool whiteToMove = board.flags & WHITE_TO_MOVE_BIT;
+    auto start = std::chrono::steady_clock::now();
+    search.analyze(board, args.size() > 2 ? std::stoi(args[2]) : 6, args.size() > 3 ? std::stoi(args[3]) : 3,
+                   args.size() > 4 ? std::stoull(args[4]) : 0, [&](int depth, std::vector<AnalysisLine> const &lines){
+      u64 ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now()-start).count();
+      for(size_t i = 0; i<lines.size(); i++){
+        std::cout<<"depth "<<depth<<" multipv "<<i+1<<" score "<<lines[i].score<<" nodes "<<search.nodes<<" time "<<ms;
+        std::cout<<" pv "<<debug::lineToUci(lines[i].pv, whiteToMove)<<"\n";
+      }
+      std::cout<<std::flush;
+    });
+    EvalStats const &eval = search.evalStats;
+    std::cout<<"[eval: "<<eval.calls<<" calls, "<<eval.nsPerCall()<<" ns/call, eval cache hits "<<eval.cacheHitRate()*100;
+    std::cout<<"%, pawn hash hits "<<eval.pawnHitRate()*100<<"%]"<<std::endl;
+    return 0;
+  }
+  if(mode == "mate"){
+    //mate <fen> [moves] [nodes] [table MB]
+    if(args.size() < 2 || !board.loadFromFEN(args[1])){
+      std::cout<<"usage: mate \"<fen>\" [moves] [nodes] [table MB]"<<std::endl;
+      return 1;
+    }
+    int moves = args.size() > 2 ? std::stoi(args[2]) : 5;
+    if(moves < 1 || moves > MAX_MATE_MOVES){
+      std::cout<<"[error] The number of moves must be 1 to "<<MAX_MATE_MOVES<<std::endl;
+      return 1;
+    }
+    search.mateTable = std::make_shared<MateTable>(args.size() > 4 ? std::stoi(args[4]) : 64);
+    bool whiteToMove = board.flags & WHITE_TO_MOVE_BIT;
+    MateResult result = search.solveMate(board, moves, args.size() > 3 ? std::stoull(args[3]) : 0);
+    if(!result.found) std::cout<<"no mate found";
+    else std::cout<<(result.winning ? "mate in " : "mated in ")<<result.moves<<" line "<<debug::lineToUci(result.line, whiteToMove);
+    std::cout<<"\nnodes "<<result.nodes<<" time "<<result.ns/1000000<<"ms nodes/s "<<(u64)(result.nodes*1e9/(result.ns ? result.ns : 1));
+    std::cout<<" [table: "<<search.mateTable->size()/1024<<" KB, "<<search.mateTable->fill()/10<<"% full, ";
+    std::cout<<search.mateTable->collections<<" collections]"<<std::endl;
+    return 0;
+  }
+  if(mode == "batch"){
+    //batch <moves|status|perft|best|wdl> <input> <output> [depth] [threads]
+    if(args.size() < 4){
+      std::cout<<"usage: batch <moves|status|perft|best|wdl> <input> <output> [depth] [threads]"<<std::endl;
+      return 1;
+    }
+    BatchOptions options;
+    options.task = args[1];
+    options.input = args[2];
+    options.output = args[3];
+    if(args.size() > 4) options.depth = std::stoi(args[4]);
+    if(args.size() > 5) options.threads = std::stoi(args[5]);
+    BatchRunner runner(search, options);
+    return runner.run() ? 0 : 1;
+  }
+  if(mode == "serve"){
+    //serve <socket> [threads] [queue]
+    if(args.size() < 2){
+      std::cout<<"usage: serve <socket> [threads] [queue]"<<std::endl;
+      return 1;
+    }
+    ServerOptions options;
+    options.socketPath = args[1];
+    if(args.size() > 2) options.threads = std::stoi(args[2]);
+    if(args.size() > 3) options.maxQueue = std::stoi(args[3]);
+    options.hashMegabytes = hashMegabytes;
+    AnalysisServer server(search, options);
+    return server.run() ? 0 : 1;
+  }
+  if(mode == "datagen"){
+    //datagen <output> <games> [depth] [nodes] [threads] [seed]
+    if(args.size() < 3){
+      std::cout<<"usage: datagen <output> <games> [depth] [nodes] [threads] [seed]"<<std::endl;
+      return 1;
+    }
+    DatagenOptions options;
+    options.output = args[1];
+    options.games = std::stoull(args[2]);
+    if(args.size() > 3) options.depth = std::stoi(args[3]);
+    if(args.size() > 4) options.nodes = std::stoull(args[4]);
+    if(args.size() > 5) options.threads = std::stoi(args[5]);
+    if(args.size() > 6) options.seed = std::stoull(args[6]);
+    DataGenerator generator(search, options);
+    return generator.run() ? 0 : 1;
+  }
+  if(mode == "match"){
+    //match <engine1> <engine2> [games] [threads] [openings] [pgn]
+    if(args.size() < 3){
+      std::cout<<"usage: match <engine1> <engine2> [games] [threads] [openings] [pgn]"<<std::endl;
+      std::cout<<"engines are key=value lists, e.g. name=base,nodes=20000 or name=nolmr,nodes=20000,disable=lmr+nmp"<<std::endl;
+      return 1;
+    }
+    MatchOptions options;
+    if(!parseEngineConfig(args[1], options.engines[0]) || !parseEngineConfig(args[2], options.engines[1])) return 1;
+    if(args.size() > 3) options.games = std::stoull(args[3]);
+    if(args.size() > 4) options.threads = std::stoi(args[4]);
+    if(args.size() > 5 && args[5] != "-") options.openings = args[5];
+    if(args.size() > 6) options.pgn = args[6];
+    options.hashMegabytes = hashMegabytes;
+    options.elo0 = sprtElo0;
+    options.elo1 = sprtElo1;
+    MatchRunner runner(search, options);
+    return runner.run() ? 0 : 1;
+  }
+  if(mode == "tune"){
+    //tune <dataset> <output> [epochs] [threads] [learning rate]
+    if(args.size() < 3){
+      std::cout<<"usage: tune <dataset> <output> [epochs] [threads] [learning rate]"<<std::endl;
+      return 1;
+    }
+    TunerOptions options;
+    options.dataset = args[1];
+    options.output = args[2];
+    if(args.size() > 3) options.epochs = std::stoi(args[3]);
+    if(args.size() > 4) options.threads = std::stoi(args[4]);
+    if(args.size() > 5) options.learningRate = std::stod(args[5]);
+    Tuner tuner(search, options);
+    return tuner.run() ? 0 : 1;
+  }
+  search.tt = std::make_shared<TranspositionTable>(hashMegabytes);
+  std::cout<<"[hash: "<<search.tt->size()/(1024*1024)<<" MB, "<<pageBackingName(search.tt->backing)<<"]\n";
   std::cout<<"[creating consoleInterface...]\n";
   ConsoleInterface consoleInterface;
   std::cout<<"[beginning consoleInterface...]\n";
@@ -48,19 +48,7 @@ std::string debug::moveToStr(Move m, bool expanded){
       }
     }
     str.append("\x1b[0m");
-    str.append("\nUnmake Data: ");
-    for(int i = 15; i>=0;i--){
-      str.append("\x1b[2;30m");
-      if(i>=2) str.append("\x1b[0;34m");
-      if(i>=6) str.append("\x1b[0;33m");
-      if(i>=12) str.append("\x1b[0;32m");
-      if((m.getUnmakeData()>>i)&(unsigned short)1){
-        str.push_back('1');
-      }else{
-        str.push_back('0');
-      }
-    }
-    str.append("\n\x1b[0m");
+    str.append("\n");
     str.append("isKingside: " + std::to_string(m.isKingside())+"\n");
     str.append("isQueenside: " + std::to_string(m.isQueenside())+"\n");
     str.append("isEnPassan: " + std::to_string(m.isEnPassan())+"\n");
@@ -68,8 +56,6 @@ std::string debug::moveToStr(Move m, bool expanded){
     str.append("toSquare: " + std::to_string(m.getTo())+"\n");
     str.append("fromSquare: " + std::to_string(m.getFrom())+"\n");
     str.append("promotionPiece: " + std::to_string(m.getPromotionPiece())+"\n");
-    str.append("capturedPiece: " + std::to_string(m.getCapturedPiece())+"\n");
-    str.append("enPassanTarget: " + std::to_string(m.getEnPassanTarget())+"\n");
     str.append("\x1b[0m");
     str.append("\n");
   }
@@ -104,7 +90,29 @@ std::string debug::moveToStr(Move m, bool expanded){
   }
   return str;
 };
-std::string debug::printBoard(Settings settings, Board const &board, u64 highlighted){
+std::string debug::moveToUci(Move m, bool whiteToMove){
+  if(m.isKingside()) return whiteToMove ? "e1g1" : "e8g8";
+  if(m.isQueenside()) return whiteToMove ? "e1c1" : "e8c8";
+  std::string str = "";
+  str.push_back('h'-(m.getFrom()%8));
+  str.push_back('1'+(m.getFrom()/8));
+  str.push_back('h'-(m.getTo()%8));
+  str.push_back('1'+(m.getTo()/8));
+  if(m.isPromotion()){
+    str.push_back("pbnrqk"[m.getPromotionPiece()%6]);
+  }
+  return str;
+};
+std::string debug::lineToUci(std::vector<Move> const &line, bool whiteToMove){
+  std::string str = "";
+  for(Move m : line){
+    if(str != "") str.push_back(' ');
+    str.append(moveToUci(m, whiteToMove));
+    whiteToMove = !whiteToMove;
+  }
+  return str;
+}
+std::string debug::printBoard(Settings settings, Position const &board, u64 highlighted){
   std::string str = "";
   if(!board.validate()){
     str.append("\x1b[31m[error]Board is invalid\x1b[0m\n");
@@ -122,8 +130,8 @@ std::string debug::printBoard(Settings settings, Board const &board, u64 highlig
         str.append(settings.darkColor);
       }
       if(getBit(highlighted,getSquareIndex(file, rank))) str.append("\x1b[45m");
-      std::string piece = settings.pieceCharacters[board.squares[getSquareIndex(file,rank)]];
-      //std::string piece = std::to_string(board.squares[getSquareIndex(file,rank)]);
+      std::string piece = settings.pieceCharacters[board.piece(getSquareIndex(file,rank))];
+      //std::string piece = std::to_string(board.piece(getSquareIndex(file,rank)));
       str.append("\x1b[30m"+piece + " \x1b[0m");
     }
     str.append("\x1b[0m" + std::to_string(file+1)+ "\n");
@@ -132,7 +140,7 @@ std::string debug::printBoard(Settings settings, Board const &board, u64 highlig
   return str;
 };
 
-std::string debug::printMove(Settings settings, Board const board, Move m){
+std::string debug::printMove(Settings settings, Position const &board, Move m){
   u64 highlightedSquares = (u64)0;
   setBit(highlightedSquares,m.getTo());
   setBit(highlightedSquares,m.getFrom());
@@ -163,6 +171,6 @@ std::string debug::printMove(Settings settings, Board const board, Move m){
   return printBoard(settings,board,highlightedSquares);
 };
 
-std::string debug::printBitboard(debug::Settings settings,Board board,u64 const &bb){
+std::string debug::printBitboard(debug::Settings settings,Position const &board,u64 const &bb){
   return printBoard(settings, board, bb);
 };
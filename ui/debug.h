@@ -14,11 +14,13 @@ namespace debug{
     void setUnicodePieces();
   };
   std::string testFormatting(bool highlightOnly = false);
-  std::string printBoard(Settings settings, Board const &board, u64 highlighted = u64(0));
+  std::string printBoard(Settings settings, Position const &board, u64 highlighted = u64(0));
 
-  std::string printMove(Settings settings, Board const board, Move m);
+  std::string printMove(Settings settings, Position const &board, Move m);
   std::string moveToStr(Move m, bool expanded = false);
-  std::string printBitboard(debug::Settings settings,Board board,u64 const &bb);
+  std::string moveToUci(Move m, bool whiteToMove);//long algebraic, e.g. "e2e4", castling is written as the king move
+  std::string lineToUci(std::vector<Move> const &line, bool whiteToMove);//space separated, sides alternate from whiteToMove
+  std::string printBitboard(debug::Settings settings,Position const &board,u64 const &bb);
 
   void runMoveGenerationTest();
 }
@@ -8,6 +8,11 @@ void ConsoleInterface::run(Board &board, Search &search){
     if(c.printBoard) c.output = "\n" + debug::printBoard(c.settings,board) + c.output;
     getNextInput();
     std::string input = c.lastInput;
+    bool moving = input == "mve" || input == "rnd" || input == "ks" || input == "qs";
+    if(moving && board.ply >= MAX_ROOT_PLY){
+      c.output = "The game is too long to search any further, undo some moves first\n";
+      continue;
+    }
     if (input == "mve") makeMoveFromConsole(board, search);
     if(input == "dsp")  displaySettings();
     if (input == "lgl") printLegalMoves(board, search);
@@ -17,8 +22,12 @@ void ConsoleInterface::run(Board &board, Search &search){
     if(input == "sch") search.searchForMagics();
     if(input == "tst") search.runMoveGenerationTest(board);
     if(input == "mgs") search.runMoveGenerationSuite();
+    if(input == "bch" || input == "bench") search.runBench();
     if(input == "und") undoLastMove(board); 
     if(input == "dbg") showDebugView(board);
+    if(input == "fen") printFEN(board);
+    if(input == "bok") printBookMoves(board, search);
+    if(input == "anl") analyzePosition(board, search);
     if(input == "q" || input == "quit" || input == "exit") quit = true;
 
     if(input == "ks"){
@@ -74,12 +83,16 @@ void ConsoleInterface::showHelpMenu(){
       + "  lgl - Show legal moves\n"
       + "  dsp - Display settings\n"
       + "  dbg - Debug View\n"
+      + "  fen - Print the position as a fen\n"
+      + "  bok - Show opening book moves (needs --book=FILE)\n"
+      + "  anl - Analyze the position, the best 3 moves to depth 6\n"
       + "  rnd - Random move\n"
-      + "  sch - \"Search\" for magic numbers\n"
+      + "  sch - Search for smaller magic numbers (10s, all cores)\n"
       + "  und - Undo last move\n"
       + "  hlp/help - Show this list\n"
       + "  tst - Run move generation test on current position\n"
       + "  mgs - Run move generation test suite\n"
+      + "  bch/bench - Run benchmark, prints a node count signature\n"
       + "  q - Quit\n"
       + "Note that if no command is entered, the last command given is repeated");
 }
@@ -210,7 +223,7 @@ void ConsoleInterface::displaySettings(){
 void ConsoleInterface::showDebugView(Board &board){
   c.printBoard = false;
   for(int i = 0; i<14; i++){
-    c.output.append(debug::printBitboard(c.settings, board, board.bitboards[i]));
+    c.output.append(debug::printBitboard(c.settings, board, board.bitboard(i)));
     c.output.append("\n");
   }
   for(int i = 7; i>=0; i--){
@@ -222,3 +235,38 @@ void ConsoleInterface::showDebugView(Board &board){
   }
   c.output.append("\n");
 }
+
+void ConsoleInterface::printFEN(Board &board){
+  char fen[FEN_BUFFER_SIZE];
+  board.toFEN(fen);
+  c.output = std::string(fen) + "\n";
+}
+
+void ConsoleInterface::printBookMoves(Board &board, Search &search){
+  c.printBoard = false;
+  if(!search.book){
+    c.output = "No book loaded, start with --book=FILE\n";
+    return;
+  }
+  auto start = std::chrono::high_resolution_clock::now();
+  std::vector<OpeningBook::Entry> entries = search.book->probeAll(board, search);
+  auto end = std::chrono::high_resolution_clock::now();
+  c.output = std::to_string(entries.size()) + " book moves";
+  c.output += " (" + std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(end-start).count()) + "us)\n";
+  for(OpeningBook::Entry &e : entries){
+    c.output += "  " + debug::moveToUci(e.move, board.flags & WHITE_TO_MOVE_BIT) + " " + std::to_string(e.weight) + "\n";
+  }
+}
+
+void ConsoleInterface::analyzePosition(Board &board, Search &search){
+  c.printBoard = false;
+  bool whiteToMove = board.flags & WHITE_TO_MOVE_BIT;
+  std::vector<AnalysisLine> lines = search.analyze(board, 6, 3, 0, [&](int depth, std::vector<AnalysisLine> const &lines){
+    std::cout<<"depth "<<depth<<"\n";
+    for(AnalysisLine const &line : lines){
+      std::cout<<"  "<<line.score<<" "<<debug::lineToUci(line.pv, whiteToMove)<<"\n";
+    }
+    std::cout<<std::flush;
+  });
+  c.output = std::to_string(lines.size()) + " lines, " + std::to_string(search.nodes) + " nodes\n";
+}
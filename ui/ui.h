@@ -28,6 +28,9 @@ class ConsoleInterface{
   void makeRandomMove(Board &board, Search &search);
   void printLegalMoves(Board &board, Search &search);
   void showDebugView(Board &board);
+  void printFEN(Board &board);
+  void printBookMoves(Board &board, Search &search);
+  void analyzePosition(Board &board, Search &search);
 public:
   void run(Board &board, Search &search);//run the console interface
 };
\ No newline at end of file